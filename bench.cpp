@@ -0,0 +1,624 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+/*
+ * Microbenchmarks for the hot paths of snpBridge, on synthetic graphs
+ * and genotypes (fixed random seed, so runs are repeatable).  Each
+ * benchmark is run a number of times and the fastest is reported, in
+ * nanoseconds and heap allocations per operation.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <cassert>
+#include <new>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "vg/src/vg.hpp"
+
+#include "snpbridge.h"
+
+using namespace vg;
+using namespace std;
+
+// every call to operator new is counted
+static size_t numAllocs = 0;
+
+void* operator new(size_t size)
+{
+  ++numAllocs;
+  void* p = malloc(size > 0 ? size : 1);
+  if (p == NULL)
+  {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+static const string PathName = "bench";
+
+struct BenchParams
+{
+  int numSamples;
+  int numAlleles;
+  /** bases of reference between adjacent variants */
+  int spacing;
+  /** nodes of reference between adjacent variants */
+  int refNodes;
+  int numVariants;
+  int numRepeats;
+};
+
+/** time (and count allocations in) some sections of a benchmark */
+class BenchTimer
+{
+public:
+  BenchTimer() : _ns(0), _allocs(0) {}
+  void start()
+  {
+    _allocStart = numAllocs;
+    _start = chrono::steady_clock::now();
+  }
+  void stop()
+  {
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    _ns += chrono::duration_cast<chrono::nanoseconds>(end - _start).count();
+    _allocs += numAllocs - _allocStart;
+  }
+  double getNs() const { return _ns; }
+  double getAllocs() const { return _allocs; }
+protected:
+  chrono::steady_clock::time_point _start;
+  size_t _allocStart;
+  double _ns;
+  double _allocs;
+};
+
+/** expose the protected parts of SNPBridge we want to time */
+class BenchBridge : public SNPBridge
+{
+public:
+  using SNPBridge::computeLinkCounts;
+  using SNPBridge::phaseRelation;
+
+  void setGraph(VG* vg)
+  {
+    _vg = vg;
+    _edits.init(vg);
+  }
+  void loadPair(const PathIndex* path, const VCFSite& v1, const VCFSite& v2)
+  {
+    _gv1.init(path, 1);
+    _gv2.init(path, 1);
+    _gv1.loadVariant(_vg, v1);
+    _gv2.loadVariant(_vg, v2);
+    _segments.clear();
+  }
+  void bridge(int allele1, int allele2, Phase phase)
+  {
+    makeBridge(allele1, allele2, phase);
+  }
+  void applyEdits()
+  {
+    _edits.apply();
+  }
+};
+
+static void printResult(const string& name, const BenchParams& params,
+                        size_t numOps, const BenchTimer& best)
+{
+  cout << left << setw(20) << name << right
+       << setw(9) << params.numSamples
+       << setw(9) << params.numAlleles
+       << setw(9) << params.spacing
+       << setw(9) << params.refNodes
+       << fixed << setprecision(1)
+       << setw(14) << best.getNs() / numOps
+       << setw(12) << best.getAllocs() / numOps << endl;
+}
+
+/** keep the fastest of several runs */
+static void keepBest(BenchTimer& best, const BenchTimer& timer, int repeat)
+{
+  if (repeat == 0 || timer.getNs() < best.getNs())
+  {
+    best = timer;
+  }
+}
+
+/** allele strings: snps if possible, otherwise insertions */
+static void makeAlleles(int numAlleles, vector<string>& alleles)
+{
+  static const char* snps[] = {"A", "C", "G", "T"};
+  alleles.clear();
+  for (int i = 0; i < numAlleles; ++i)
+  {
+    alleles.push_back(numAlleles <= 4 ? string(snps[i]) :
+                      "A" + string(i, 'C'));
+  }
+}
+
+/** length of each node of reference between variants */
+static int refNodeLength(const BenchParams& params)
+{
+  return max(1, params.spacing / max(1, params.refNodes));
+}
+
+/** position of variant v in the graph from makeGraph(), so the sites
+ * and records are those of the graph's bubbles.  the reference allele
+ * is always one base */
+static long variantPosition(const BenchParams& params, int v)
+{
+  return 1 + (long)(v + 1) * params.refNodes * refNodeLength(params) + v;
+}
+
+/** random phased genotypes for each variant.  each haplotype mostly
+ * keeps its allele from one variant to the next so that pairs are
+ * linked */
+static void makeRecords(const BenchParams& params, vector<GTRecord>& records)
+{
+  mt19937 rng(1234);
+  uniform_int_distribution<int> alleleDist(0, params.numAlleles - 1);
+  uniform_int_distribution<int> keepDist(0, 9);
+  static vector<string> sampleNames;
+  sampleNames.resize(params.numSamples);
+  for (int s = 0; s < params.numSamples; ++s)
+  {
+    stringstream ss;
+    ss << "sample" << s;
+    sampleNames[s] = ss.str();
+  }
+  GTRecord rec;
+  rec.sequenceName = PathName;
+  makeAlleles(params.numAlleles, rec.alleles);
+  rec.sampleNames = &sampleNames;
+  rec.ploidy = 2;
+  rec.samplePloidy.assign(params.numSamples, 2);
+  rec.haplotypes.resize(params.numSamples * 2);
+  for (auto& h : rec.haplotypes)
+  {
+    h = alleleDist(rng);
+  }
+  records.resize(params.numVariants);
+  for (int v = 0; v < params.numVariants; ++v)
+  {
+    rec.position = variantPosition(params, v);
+    for (auto& h : rec.haplotypes)
+    {
+      if (keepDist(rng) == 0)
+      {
+        h = alleleDist(rng);
+      }
+    }
+    records[v] = rec;
+  }
+}
+
+static void makeRows(const vector<GTRecord>& records,
+                     vector<GenotypeRow>& rows)
+{
+  rows.resize(records.size());
+  for (size_t v = 0; v < records.size(); ++v)
+  {
+    rows[v].load(records[v]);
+  }
+}
+
+/** graph in the style of vg construct -f: the reference path, with
+ * each variant a bubble of one node per allele, and refNodes nodes
+ * of reference in between */
+static void makeGraph(const BenchParams& params, VG& vg,
+                      vector<VCFSite>& sites)
+{
+  int64_t id = 0;
+  long position = 1;
+  // nodes whose ends connect to the next node
+  vector<Node*> ends;
+  int nodeLength = refNodeLength(params);
+
+  auto addRef = [&](const string& seq) {
+    Node* node = vg.create_node(seq, ++id);
+    for (auto end : ends)
+    {
+      vg.create_edge(end, node);
+    }
+    Mapping mapping;
+    mapping.mutable_position()->set_node_id(node->id());
+    vg.paths.append_mapping(PathName, mapping);
+    position += seq.length();
+    ends.assign(1, node);
+    return node;
+  };
+
+  VCFSite site;
+  site.sequenceName = PathName;
+  makeAlleles(params.numAlleles, site.alleles);
+  sites.clear();
+  for (int v = 0; v < params.numVariants; ++v)
+  {
+    for (int r = 0; r < params.refNodes; ++r)
+    {
+      addRef(string(nodeLength, 'T'));
+    }
+    site.position = position;
+    assert(site.position == variantPosition(params, v));
+    sites.push_back(site);
+    vector<Node*> before = ends;
+    addRef(site.alleles[0]);
+    for (int a = 1; a < params.numAlleles; ++a)
+    {
+      Node* alt = vg.create_node(site.alleles[a], ++id);
+      for (auto end : before)
+      {
+        vg.create_edge(end, alt);
+      }
+      ends.push_back(alt);
+    }
+  }
+  // so last variant has something after it
+  addRef(string(nodeLength, 'T'));
+}
+
+static void benchLinkCounts(const BenchParams& params,
+                            const vector<GenotypeRow>& rows)
+{
+  BenchTimer best;
+  SNPBridge::LinkCounts linkCounts;
+  for (int repeat = 0; repeat < params.numRepeats; ++repeat)
+  {
+    BenchTimer timer;
+    timer.start();
+    for (size_t v = 1; v < rows.size(); ++v)
+    {
+      BenchBridge::computeLinkCounts(rows[v - 1], rows[v], linkCounts);
+    }
+    timer.stop();
+    keepBest(best, timer, repeat);
+  }
+  printResult("computeLinkCounts", params, rows.size() - 1, best);
+}
+
+static void benchPhaseRelation(const BenchParams& params,
+                               const vector<GenotypeRow>& rows,
+                               const vector<VCFSite>& sites)
+{
+  BenchBridge snpBridge;
+  vector<SNPBridge::LinkCounts> linkCounts(rows.size());
+  for (size_t v = 1; v < rows.size(); ++v)
+  {
+    BenchBridge::computeLinkCounts(rows[v - 1], rows[v], linkCounts[v]);
+  }
+  // warnings are only counted
+  snpBridge.getDiagnostics().setVerbosity(Diagnostics::Quiet);
+  BenchTimer best;
+  size_t numOps = 0;
+  for (int repeat = 0; repeat < params.numRepeats; ++repeat)
+  {
+    BenchTimer timer;
+    numOps = 0;
+    timer.start();
+    for (size_t v = 1; v < rows.size(); ++v)
+    {
+      for (int a1 = 1; a1 < params.numAlleles; ++a1)
+      {
+        for (int a2 = 1; a2 < params.numAlleles; ++a2, ++numOps)
+        {
+          snpBridge.phaseRelation(linkCounts[v], sites[v - 1], a1,
+                                  sites[v], a2);
+        }
+      }
+    }
+    timer.stop();
+    keepBest(best, timer, repeat);
+  }
+  printResult("phaseRelation", params, numOps, best);
+}
+
+static void benchLoadVariant(const BenchParams& params)
+{
+  VG vg;
+  vector<VCFSite> sites;
+  makeGraph(params, vg, sites);
+  PathIndex path;
+  path.build(&vg, PathName);
+  GraphVariant gv;
+  gv.init(&path, 1);
+
+  BenchTimer best;
+  for (int repeat = 0; repeat < params.numRepeats; ++repeat)
+  {
+    BenchTimer timer;
+    timer.start();
+    for (auto& site : sites)
+    {
+      gv.loadVariant(&vg, site);
+    }
+    timer.stop();
+    keepBest(best, timer, repeat);
+  }
+  printResult("loadVariant", params, sites.size(), best);
+}
+
+static void benchMakeBridge(const BenchParams& params)
+{
+  BenchTimer best;
+  size_t numOps = 0;
+  for (int repeat = 0; repeat < params.numRepeats; ++repeat)
+  {
+    // bridges change the graph, so each run gets a new one
+    VG vg;
+    vector<VCFSite> sites;
+    makeGraph(params, vg, sites);
+    PathIndex path;
+    path.build(&vg, PathName);
+    BenchBridge snpBridge;
+    snpBridge.setGraph(&vg);
+
+    BenchTimer timer;
+    numOps = 0;
+    for (size_t v = 1; v < sites.size(); ++v)
+    {
+      snpBridge.loadPair(&path, sites[v - 1], sites[v]);
+      timer.start();
+      for (int a = 1; a < params.numAlleles; ++a, ++numOps)
+      {
+        snpBridge.bridge(a, a, SNPBridge::GT_AND);
+      }
+      timer.stop();
+    }
+    timer.start();
+    snpBridge.applyEdits();
+    timer.stop();
+    keepBest(best, timer, repeat);
+  }
+  printResult("makeBridge", params, numOps, best);
+}
+
+/** write the records as two vcf shards: the first half of the samples
+ * diploid in one, the rest haploid (first haplotype only) in the other.
+ * the other shard also has a copy of sample0, which setSamples() must
+ * drop */
+static void writeShards(const vector<GTRecord>& records,
+                        const vector<string>& paths)
+{
+  const vector<string>& names = *records[0].sampleNames;
+  size_t half = max((size_t)1, names.size() / 2);
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    size_t first = i == 0 ? 0 : half;
+    size_t last = i == 0 ? half : names.size();
+    ofstream vcf(paths[i].c_str());
+    vcf << "##fileformat=VCFv4.2\n"
+        << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+    for (size_t s = first; s < last; ++s)
+    {
+      vcf << "\t" << names[s];
+    }
+    if (i > 0)
+    {
+      vcf << "\t" << names[0];
+    }
+    vcf << "\n";
+    for (auto& rec : records)
+    {
+      vcf << rec.sequenceName << "\t" << rec.position << "\t.\t"
+          << rec.alleles[0] << "\t";
+      for (size_t a = 1; a < rec.alleles.size(); ++a)
+      {
+        vcf << (a > 1 ? "," : "") << rec.alleles[a];
+      }
+      vcf << "\t.\t.\t.\tGT";
+      for (size_t s = first; s < last; ++s)
+      {
+        vcf << "\t" << rec.haplotypes[s * 2];
+        if (i == 0)
+        {
+          vcf << "|" << rec.haplotypes[s * 2 + 1];
+        }
+      }
+      if (i > 0)
+      {
+        vcf << "\t" << rec.haplotypes[0] << "|" << rec.haplotypes[1];
+      }
+      vcf << "\n";
+    }
+    if (!vcf)
+    {
+      throw runtime_error("Could not write " + paths[i]);
+    }
+  }
+}
+
+/** read the records back from two shards in lockstep, with the haploid
+ * shard's samples padded to the diploid ploidy */
+static void benchMergedGTReader(const BenchParams& params,
+                                const vector<GTRecord>& records)
+{
+  vector<string> paths;
+  for (int i = 0; i < 2; ++i)
+  {
+    char path[] = "/tmp/snpBridgeBenchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+      throw runtime_error("Could not make a temporary file");
+    }
+    close(fd);
+    paths.push_back(path);
+  }
+  writeShards(records, paths);
+  const vector<string>& names = *records[0].sampleNames;
+  size_t half = max((size_t)1, names.size() / 2);
+
+  BenchTimer best;
+  GTRecord rec;
+  for (int repeat = 0; repeat < params.numRepeats; ++repeat)
+  {
+    BenchTimer timer;
+    timer.start();
+    MergedGTReader reader;
+    reader.open(paths[0] + "," + paths[1]);
+    reader.setSamples(names);
+    size_t v = 0;
+    for (; reader.getNextRecord(rec); ++v)
+    {
+      const GTRecord& expected = records[v];
+      bool ok = rec.position == expected.position && rec.ploidy == 2 &&
+         rec.haplotypes.size() == expected.haplotypes.size();
+      for (size_t s = 0; ok && s < names.size(); ++s)
+      {
+        int h1 = rec.haplotypes[s * 2 + 1];
+        ok = rec.haplotypes[s * 2] == expected.haplotypes[s * 2] &&
+           (s < half ? h1 == expected.haplotypes[s * 2 + 1] :
+            h1 == GTRecord::Unused && rec.samplePloidy[s] == 1);
+      }
+      if (!ok)
+      {
+        stringstream ss;
+        ss << "Merged record " << v << " doesn't match what was written";
+        throw runtime_error(ss.str());
+      }
+    }
+    timer.stop();
+    if (v != records.size())
+    {
+      throw runtime_error("Merged shards are missing records");
+    }
+    keepBest(best, timer, repeat);
+  }
+  for (auto& path : paths)
+  {
+    unlink(path.c_str());
+  }
+  printResult("MergedGTReader", params, records.size(), best);
+}
+
+void help_main(char** argv)
+{
+  cerr << "usage: " << argv[0] << " [options]" << endl
+       << "Time the main steps of snpBridge on synthetic data." << endl
+       << "options:" << endl
+       << "    -h, --help          print this help message" << endl
+       << "    -s, --samples N     number of (diploid) samples"
+       << " (default=1000)" << endl
+       << "    -a, --alleles N     number of alleles per variant, reference"
+       << " included (default=2)" << endl
+       << "    -d, --spacing N     bases of reference between variants"
+       << " (default=10)" << endl
+       << "    -r, --ref-nodes N   nodes of reference between variants"
+       << " (default=1)" << endl
+       << "    -v, --variants N    number of variants (default=2000)" << endl
+       << "    -n, --repeats N     number of runs of each benchmark.  the"
+       << " fastest is reported\n                        (default=5)" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  BenchParams params = {1000, 2, 10, 1, 2000, 5};
+
+  optind = 1;
+  bool optionsRemaining = true;
+  while(optionsRemaining) {
+    static struct option longOptions[] = {
+      {"samples", required_argument, 0, 's'},
+      {"alleles", required_argument, 0, 'a'},
+      {"spacing", required_argument, 0, 'd'},
+      {"ref-nodes", required_argument, 0, 'r'},
+      {"variants", required_argument, 0, 'v'},
+      {"repeats", required_argument, 0, 'n'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}
+    };
+
+    int optionIndex = 0;
+
+    switch(getopt_long(argc, argv, "s:a:d:r:v:n:h", longOptions,
+                       &optionIndex)) {
+    case -1:
+      optionsRemaining = false;
+      break;
+    case 's':
+      params.numSamples = atol(optarg);
+      break;
+    case 'a':
+      params.numAlleles = atol(optarg);
+      break;
+    case 'd':
+      params.spacing = atol(optarg);
+      break;
+    case 'r':
+      params.refNodes = atol(optarg);
+      break;
+    case 'v':
+      params.numVariants = atol(optarg);
+      break;
+    case 'n':
+      params.numRepeats = atol(optarg);
+      break;
+    case 'h':
+      help_main(argv);
+      exit(1);
+      break;
+    default:
+      cerr << "Illegal option" << endl;
+      exit(1);
+    }
+  }
+
+  if (params.numSamples < 1 || params.numAlleles < 2 ||
+      params.spacing < 0 || params.refNodes < 0 || params.numVariants < 2 ||
+      params.numRepeats < 1)
+  {
+    help_main(argv);
+    return 1;
+  }
+  if (params.refNodes == 0)
+  {
+    // variants are adjacent
+    params.spacing = 0;
+  }
+
+  vector<GTRecord> records;
+  makeRecords(params, records);
+  vector<GenotypeRow> rows;
+  makeRows(records, rows);
+  vector<VCFSite> sites(params.numVariants);
+  makeAlleles(params.numAlleles, sites[0].alleles);
+  for (int v = 0; v < params.numVariants; ++v)
+  {
+    sites[v].sequenceName = PathName;
+    sites[v].alleles = sites[0].alleles;
+    sites[v].position = variantPosition(params, v);
+  }
+
+  cout << left << setw(20) << "benchmark" << right
+       << setw(9) << "samples" << setw(9) << "alleles" << setw(9) << "spacing"
+       << setw(9) << "refNodes" << setw(14) << "ns/op"
+       << setw(12) << "allocs/op" << endl;
+
+  benchLinkCounts(params, rows);
+  benchPhaseRelation(params, rows, sites);
+  benchLoadVariant(params);
+  benchMakeBridge(params);
+  benchMergedGTReader(params, records);
+
+  return 0;
+}
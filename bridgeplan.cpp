@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include <cstring>
+
+#include "bridgeplan.h"
+
+using namespace std;
+
+static const char PlanMagic[] = "SNPBPLAN";
+static const int PlanMagicLength = 8;
+static const char PlanVersion = 2;
+static const char NewSequenceFlag = 1;
+static const char LinkCountsFlag = 2;
+
+BridgePlanWriter::BridgePlanWriter() : _lastPosition(0), _lastNumAlleles(0),
+                                       _hasCounts(false)
+{
+}
+
+BridgePlanWriter::~BridgePlanWriter()
+{
+  close();
+}
+
+void BridgePlanWriter::open(const string& path,
+                            const vector<string>* countedSamples)
+{
+  _path = path;
+  _file.open(path.c_str(), ios::binary | ios::trunc);
+  if (!_file.good())
+  {
+    throw runtime_error("Could not write " + path);
+  }
+  _file.write(PlanMagic, PlanMagicLength);
+  _file.put(PlanVersion);
+  _hasCounts = countedSamples != NULL;
+  writeVarint(_hasCounts ? countedSamples->size() : 0);
+  for (size_t i = 0; _hasCounts && i < countedSamples->size(); ++i)
+  {
+    writeString(countedSamples->at(i));
+  }
+  _lastName.clear();
+  _lastPosition = 0;
+  _lastNumAlleles = 0;
+}
+
+bool BridgePlanWriter::hasCounts() const
+{
+  return _hasCounts;
+}
+
+void BridgePlanWriter::writeSite(
+  const VCFSite& site, const vector<SNPBridge::BridgeDecision>& bridges,
+  const SNPBridge::LinkCounts* linkCounts)
+{
+  if (linkCounts != NULL)
+  {
+    if (!_hasCounts)
+    {
+      throw runtime_error("No counted samples given for link counts in " +
+                          _path);
+    }
+    // the reader knows the number of rows from the previous site,
+    // and of columns from this one, so they have to match exactly
+    bool sameSize = linkCounts->size() == _lastNumAlleles;
+    for (size_t i = 0; sameSize && i < linkCounts->size(); ++i)
+    {
+      sameSize = linkCounts->at(i).size() == site.alleles.size();
+    }
+    if (!sameSize)
+    {
+      stringstream ss;
+      ss << "Link counts of " << site << " don't match its alleles or those "
+         << "of the previous site";
+      throw runtime_error(ss.str());
+    }
+  }
+  // only write the sequence name when it changes, and positions as
+  // deltas in between
+  bool newSequence = _lastName.empty() || site.sequenceName != _lastName ||
+     site.position < _lastPosition;
+  _file.put((newSequence ? NewSequenceFlag : 0) |
+            (linkCounts != NULL ? LinkCountsFlag : 0));
+  if (newSequence)
+  {
+    writeString(site.sequenceName);
+    writeVarint(site.position);
+  }
+  else
+  {
+    writeVarint(site.position - _lastPosition);
+  }
+  _lastName = site.sequenceName;
+  _lastPosition = site.position;
+  _lastNumAlleles = site.alleles.size();
+
+  writeVarint(site.alleles.size());
+  for (auto& allele : site.alleles)
+  {
+    writeString(allele);
+  }
+  writeVarint(bridges.size());
+  for (auto& bridge : bridges)
+  {
+    writeVarint(bridge.allele1);
+    writeVarint(bridge.allele2);
+    _file.put((char)bridge.phase);
+  }
+  if (linkCounts != NULL)
+  {
+    for (auto& row : *linkCounts)
+    {
+      for (auto count : row)
+      {
+        writeVarint(count);
+      }
+    }
+  }
+  if (!_file.good())
+  {
+    throw runtime_error("Error writing " + _path);
+  }
+}
+
+void BridgePlanWriter::close()
+{
+  if (_file.is_open())
+  {
+    _file.close();
+  }
+}
+
+void BridgePlanWriter::writeVarint(uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    _file.put((char)(v | 0x80));
+    v >>= 7;
+  }
+  _file.put((char)v);
+}
+
+void BridgePlanWriter::writeString(const string& s)
+{
+  writeVarint(s.length());
+  _file.write(s.data(), s.length());
+}
+
+BridgePlanReader::BridgePlanReader() : _lastPosition(0), _lastNumAlleles(0)
+{
+}
+
+BridgePlanReader::~BridgePlanReader()
+{
+}
+
+void BridgePlanReader::open(const string& path)
+{
+  _path = path;
+  _file.open(path.c_str(), ios::binary);
+  char magic[PlanMagicLength];
+  if (!_file.good() || !_file.read(magic, PlanMagicLength) ||
+      memcmp(magic, PlanMagic, PlanMagicLength) != 0)
+  {
+    throw runtime_error("Could not read bridge plan from " + path);
+  }
+  int version = _file.get();
+  if (version < 1 || version > PlanVersion)
+  {
+    throw runtime_error("Unsupported bridge plan version in " + path);
+  }
+  _countedSamples.clear();
+  if (version >= 2)
+  {
+    _countedSamples.resize(readVarint());
+    for (auto& name : _countedSamples)
+    {
+      readString(name);
+    }
+  }
+  _lastName.clear();
+  _lastPosition = 0;
+  _lastNumAlleles = 0;
+}
+
+bool BridgePlanReader::readSite(VCFSite& site,
+                                vector<SNPBridge::BridgeDecision>& bridges,
+                                SNPBridge::LinkCounts* linkCounts)
+{
+  int flags = _file.get();
+  if (flags == EOF)
+  {
+    return false;
+  }
+  if (flags & NewSequenceFlag)
+  {
+    readString(_lastName);
+    _lastPosition = readVarint();
+  }
+  else
+  {
+    _lastPosition += readVarint();
+  }
+  site.sequenceName = _lastName;
+  site.position = _lastPosition;
+
+  site.alleles.resize(readVarint());
+  for (auto& allele : site.alleles)
+  {
+    readString(allele);
+  }
+  bridges.resize(readVarint());
+  for (auto& bridge : bridges)
+  {
+    // bridges are between alt alleles of the previous site and this one
+    uint64_t allele1 = readVarint();
+    uint64_t allele2 = readVarint();
+    if (allele1 < 1 || allele1 >= _lastNumAlleles ||
+        allele2 < 1 || allele2 >= site.alleles.size())
+    {
+      stringstream ss;
+      ss << "Invalid alleles " << allele1 << " " << allele2 << " at "
+         << site << " in bridge plan " << _path;
+      throw runtime_error(ss.str());
+    }
+    bridge.allele1 = allele1;
+    bridge.allele2 = allele2;
+    // GT_OTHER is never written: it means no bridge
+    int phase = _file.get();
+    if (phase < SNPBridge::GT_AND || phase >= SNPBridge::GT_OTHER)
+    {
+      stringstream ss;
+      ss << "Invalid phase " << phase << " in bridge plan " << _path;
+      throw runtime_error(ss.str());
+    }
+    bridge.phase = (SNPBridge::Phase)phase;
+  }
+  // counts have to be read past even if they're not wanted
+  SNPBridge::LinkCounts& counts =
+     linkCounts != NULL ? *linkCounts : _skippedCounts;
+  counts.clear();
+  if (flags & LinkCountsFlag)
+  {
+    counts.resize(_lastNumAlleles);
+    for (auto& row : counts)
+    {
+      row.resize(site.alleles.size());
+      for (auto& count : row)
+      {
+        count = readVarint();
+      }
+    }
+  }
+  _lastNumAlleles = site.alleles.size();
+  if (!_file.good())
+  {
+    throw runtime_error("Truncated bridge plan " + _path);
+  }
+  return true;
+}
+
+const vector<string>& BridgePlanReader::getCountedSamples() const
+{
+  return _countedSamples;
+}
+
+uint64_t BridgePlanReader::readVarint()
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    int c = _file.get();
+    if (c == EOF)
+    {
+      throw runtime_error("Truncated bridge plan " + _path);
+    }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if ((c & 0x80) == 0)
+    {
+      break;
+    }
+  }
+  return v;
+}
+
+void BridgePlanReader::readString(string& s)
+{
+  s.resize(readVarint());
+  if (!s.empty())
+  {
+    _file.read(&s[0], s.length());
+  }
+}
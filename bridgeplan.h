@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _BRIDGEPLAN_H
+#define _BRIDGEPLAN_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+
+#include "gtreader.h"
+#include "snpbridge.h"
+
+/**
+A bridge plan is everything SNPBridge decides from the vcf, with no
+reference to the graph: the sequence of (non-overlapping) variant
+sites, and for each one the bridges to make from the previous site.
+It can be written once from the vcf and then applied to as many
+graphs as we like without looking at genotypes again.
+
+A plan can also keep the link counts each pair's bridges were decided
+from.  Since counts just add up over samples, that's all we need to
+redecide the bridges when more samples come along (see
+SNPBridge::updatePlan()) without the genotypes of the old ones.
+
+Binary format: "SNPBPLAN", a version byte, then
+  number of samples counted (0 if the plan has no counts), then the
+  name of each (version 2 only)
+then one record per site:
+  flags byte (bit 0 set: sequence name follows and position is
+                         absolute rather than a delta.
+              bit 1 set: link counts to the previous site follow)
+  [name length, name]
+  position (or delta)
+  number of alleles, then length and sequence of each
+  number of bridges, then allele1, allele2 and phase of each
+  [count of each allele of the previous site (row) with each allele
+   of this one (column)]
+All integers are unsigned LEB128 varints.  Version 1 plans (no counts)
+can still be read.
+*/
+
+class BridgePlanWriter
+{
+public:
+   BridgePlanWriter();
+   ~BridgePlanWriter();
+
+   /** create file and write header. if countedSamples is given, link
+    * counts of these samples can be written with the sites.
+    * throws runtime_error on failure */
+   void open(const std::string& path,
+             const std::vector<std::string>* countedSamples = NULL);
+
+   /** were counted samples given to open() */
+   bool hasCounts() const;
+
+   /** add a site and the bridges from the previous site to it, and the
+    * link counts they were decided from if there are any: one row per
+    * allele of the previous site and one column per allele of site.
+    * throws runtime_error if hasCounts() is false or they don't fit */
+   void writeSite(const VCFSite& site,
+                  const std::vector<SNPBridge::BridgeDecision>& bridges,
+                  const SNPBridge::LinkCounts* linkCounts = NULL);
+
+   void close();
+
+protected:
+
+   void writeVarint(uint64_t v);
+   void writeString(const std::string& s);
+
+protected:
+
+   std::string _path;
+   std::ofstream _file;
+   std::string _lastName;
+   long _lastPosition;
+   /** number of alleles of the last site: rows of the next counts */
+   size_t _lastNumAlleles;
+   bool _hasCounts;
+};
+
+class BridgePlanReader
+{
+public:
+   BridgePlanReader();
+   ~BridgePlanReader();
+
+   /** open file and check header. throws runtime_error on failure */
+   void open(const std::string& path);
+
+   /** read the next site.  returns false at end of file.  if
+    * linkCounts is given, it gets the site's link counts to the
+    * previous site, or is cleared if it doesn't have any */
+   bool readSite(VCFSite& site,
+                 std::vector<SNPBridge::BridgeDecision>& bridges,
+                 SNPBridge::LinkCounts* linkCounts = NULL);
+
+   /** samples the plan's link counts are of.  empty if it has none */
+   const std::vector<std::string>& getCountedSamples() const;
+
+protected:
+
+   uint64_t readVarint();
+   void readString(std::string& s);
+
+protected:
+
+   std::string _path;
+   std::ifstream _file;
+   std::string _lastName;
+   long _lastPosition;
+   /** number of alleles of the last site read: rows of the next counts */
+   size_t _lastNumAlleles;
+   std::vector<std::string> _countedSamples;
+   SNPBridge::LinkCounts _skippedCounts;
+};
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include "checkpoint.h"
+
+using namespace std;
+
+static const char CheckpointMagic[] = "SNPBCKPT";
+static const int CheckpointMagicLength = 8;
+static const char CheckpointVersion = 2;
+
+CheckpointWriter::CheckpointWriter()
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+}
+
+void CheckpointWriter::write(const string& path, const Checkpoint& checkpoint)
+{
+  string tempPath = path + ".tmp";
+  _file.open(tempPath.c_str(), ios::binary | ios::trunc);
+  if (!_file.good())
+  {
+    throw runtime_error("Could not write " + tempPath);
+  }
+  _file.write(CheckpointMagic, CheckpointMagicLength);
+  _file.put(CheckpointVersion);
+  writeString(checkpoint.graphFile);
+  writeString(checkpoint.vcfFile);
+  writeVarint(checkpoint.samples.size());
+  for (auto& name : checkpoint.samples)
+  {
+    writeString(name);
+  }
+  writeVarint(checkpoint.donePaths.size());
+  for (auto& name : checkpoint.donePaths)
+  {
+    writeString(name);
+  }
+
+  const GTRecord& site = checkpoint.site;
+  writeString(site.sequenceName);
+  writeVarint(site.position);
+  writeVarint(site.alleles.size());
+  for (auto& allele : site.alleles)
+  {
+    writeString(allele);
+  }
+  writeVarint(site.ploidy);
+  writeVarint(site.samplePloidy.size());
+  for (auto ploidy : site.samplePloidy)
+  {
+    writeVarint(ploidy);
+  }
+  assert(site.haplotypes.size() == site.samplePloidy.size() * site.ploidy);
+  for (auto allele : site.haplotypes)
+  {
+    writeSigned(allele);
+  }
+  writeVarint(checkpoint.alleleIds.size());
+  for (auto& ids : checkpoint.alleleIds)
+  {
+    writeVarint(ids.size());
+    for (auto id : ids)
+    {
+      writeVarint(id);
+    }
+  }
+
+  writeVarint(checkpoint.vcfOffset + 1);
+  writeVarint(checkpoint.logLength);
+  writeVarint(checkpoint.logLastId);
+  _file.close();
+  if (_file.fail())
+  {
+    throw runtime_error("Error writing " + tempPath);
+  }
+  if (rename(tempPath.c_str(), path.c_str()) != 0)
+  {
+    throw runtime_error("Could not replace " + path + " with " + tempPath);
+  }
+}
+
+void CheckpointWriter::writeVarint(uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    _file.put((char)(v | 0x80));
+    v >>= 7;
+  }
+  _file.put((char)v);
+}
+
+void CheckpointWriter::writeSigned(int64_t v)
+{
+  writeVarint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+void CheckpointWriter::writeString(const string& s)
+{
+  writeVarint(s.length());
+  _file.write(s.data(), s.length());
+}
+
+CheckpointReader::CheckpointReader()
+{
+}
+
+CheckpointReader::~CheckpointReader()
+{
+}
+
+bool CheckpointReader::read(const string& path, Checkpoint& checkpoint)
+{
+  _path = path;
+  _file.open(path.c_str(), ios::binary);
+  if (!_file.is_open())
+  {
+    return false;
+  }
+  char magic[CheckpointMagicLength];
+  if (!_file.read(magic, CheckpointMagicLength) ||
+      memcmp(magic, CheckpointMagic, CheckpointMagicLength) != 0)
+  {
+    throw runtime_error("Could not read checkpoint from " + path);
+  }
+  if (_file.get() != CheckpointVersion)
+  {
+    throw runtime_error("Unsupported checkpoint version in " + path);
+  }
+  readString(checkpoint.graphFile);
+  readString(checkpoint.vcfFile);
+  checkpoint.samples.resize(readVarint());
+  for (auto& name : checkpoint.samples)
+  {
+    readString(name);
+  }
+  checkpoint.donePaths.resize(readVarint());
+  for (auto& name : checkpoint.donePaths)
+  {
+    readString(name);
+  }
+
+  GTRecord& site = checkpoint.site;
+  readString(site.sequenceName);
+  site.position = readVarint();
+  site.alleles.resize(readVarint());
+  for (auto& allele : site.alleles)
+  {
+    readString(allele);
+  }
+  site.ploidy = readVarint();
+  site.samplePloidy.resize(readVarint());
+  for (auto& ploidy : site.samplePloidy)
+  {
+    ploidy = readVarint();
+  }
+  site.haplotypes.resize(site.samplePloidy.size() * site.ploidy);
+  for (auto& allele : site.haplotypes)
+  {
+    allele = readSigned();
+  }
+  checkpoint.alleleIds.resize(readVarint());
+  for (auto& ids : checkpoint.alleleIds)
+  {
+    ids.resize(readVarint());
+    for (auto& id : ids)
+    {
+      id = readVarint();
+    }
+  }
+
+  checkpoint.vcfOffset = (int64_t)readVarint() - 1;
+  checkpoint.logLength = readVarint();
+  checkpoint.logLastId = readVarint();
+  if (!_file.good())
+  {
+    throw runtime_error("Truncated checkpoint " + path);
+  }
+  _file.close();
+  return true;
+}
+
+uint64_t CheckpointReader::readVarint()
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    int c = _file.get();
+    if (c == EOF)
+    {
+      throw runtime_error("Truncated checkpoint " + _path);
+    }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if ((c & 0x80) == 0)
+    {
+      break;
+    }
+  }
+  return v;
+}
+
+int64_t CheckpointReader::readSigned()
+{
+  uint64_t v = readVarint();
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+void CheckpointReader::readString(string& s)
+{
+  s.resize(readVarint());
+  if (!s.empty())
+  {
+    _file.read(&s[0], s.length());
+  }
+}
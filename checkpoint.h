@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+
+#include "gtreader.h"
+
+/**
+Where a run of SNPBridge::processGraph() had got to, saved every so
+often so that if it's killed it can carry on from there instead of
+starting over.  The edits made up to that point are in an edit log
+(a graph delta, see GraphDeltaWriter), of which the checkpoint
+records the length: the graph at the checkpoint is the input graph
+with the log applied.  The rest is where to pick up bridging: the
+paths already done, the last variant bridged (with its genotypes,
+which the next pair needs, and its nodes in the graph), and where the
+record after it starts in the vcf.
+
+Binary format: "SNPBCKPT", a version byte, then
+  graph and vcf file names (the vcf name is the whole list if several
+  are merged)
+  number of samples read from the vcf, then each name
+  number of paths done, then each name
+  the last variant: sequence name, position, number of alleles,
+  then length and sequence of each, ploidy, number of samples, then
+  each sample's ploidy, then the haplotypes (zigzag encoded)
+  number of nodes of each allele of the last variant, then their ids
+  vcf offset + 1 (0 if the vcf can't seek)
+  edit log length, last node id written to the edit log
+All integers are unsigned LEB128 varints.
+
+A checkpoint is written to a temporary file that's then renamed over
+the last one, so there's always a whole one to resume from.
+*/
+struct Checkpoint
+{
+   Checkpoint() : vcfOffset(-1), logLength(0), logLastId(0) {}
+   std::string graphFile;
+   std::string vcfFile;
+   /** samples read from the vcf (after --samples), in order.  link
+    * counts from other samples can't be mixed in */
+   std::vector<std::string> samples;
+   /** paths finished, in the order they were done */
+   std::vector<std::string> donePaths;
+   /** the last variant bridged */
+   GTRecord site;
+   /** ids of the graph nodes of each allele of site */
+   std::vector<std::vector<int64_t> > alleleIds;
+   /** GTReader::tell() of the record after site, or -1 */
+   int64_t vcfOffset;
+   /** GraphDeltaWriter::tell() and getLastId() of the edit log */
+   int64_t logLength;
+   int64_t logLastId;
+};
+
+class CheckpointWriter
+{
+public:
+   CheckpointWriter();
+   ~CheckpointWriter();
+
+   /** write checkpoint to path, replacing whatever was there.  throws
+    * runtime_error on failure */
+   void write(const std::string& path, const Checkpoint& checkpoint);
+
+protected:
+
+   void writeVarint(uint64_t v);
+   void writeSigned(int64_t v);
+   void writeString(const std::string& s);
+
+protected:
+
+   std::ofstream _file;
+};
+
+class CheckpointReader
+{
+public:
+   CheckpointReader();
+   ~CheckpointReader();
+
+   /** read the checkpoint in path.  returns false if there isn't one.
+    * throws runtime_error if there is but it can't be read */
+   bool read(const std::string& path, Checkpoint& checkpoint);
+
+protected:
+
+   uint64_t readVarint();
+   int64_t readSigned();
+   void readString(std::string& s);
+
+protected:
+
+   std::string _path;
+   std::ifstream _file;
+};
+
+#endif
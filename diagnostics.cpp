@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include "diagnostics.h"
+
+using namespace std;
+
+static const char* KindNames[] = {
+  "samples with no GT (assumed unphased)",
+  "alternate alleles never seen in GT",
+  "variants skipped because they overlap the previous one"};
+
+Diagnostics::Diagnostics() : _verbosity(Summary), _counts(NumKinds, 0),
+                             _examples(NumKinds)
+{
+}
+
+Diagnostics::~Diagnostics()
+{
+}
+
+void Diagnostics::setVerbosity(int verbosity)
+{
+  _verbosity = verbosity;
+}
+
+bool Diagnostics::warn(Kind kind)
+{
+  size_t count;
+#pragma omp atomic capture
+  count = ++_counts[kind];
+  return _verbosity >= Verbose ||
+     (_verbosity >= Summary && count <= MaxExamples);
+}
+
+void Diagnostics::example(Kind kind, const string& message)
+{
+#pragma omp critical(diagnostics)
+  {
+    if (_verbosity >= Verbose)
+    {
+      cerr << "Warning: " << message << endl;
+    }
+    else
+    {
+      _examples[kind].push_back(message);
+    }
+  }
+}
+
+size_t Diagnostics::getCount(Kind kind) const
+{
+  return _counts[kind];
+}
+
+void Diagnostics::report(ostream& os)
+{
+  for (int i = 0; i < NumKinds; ++i)
+  {
+    if (_counts[i] > 0)
+    {
+      os << "Warning: " << _counts[i] << " " << KindNames[i] << endl;
+      for (auto& message : _examples[i])
+      {
+        os << "    eg " << message << endl;
+      }
+    }
+    _counts[i] = 0;
+    _examples[i].clear();
+  }
+}
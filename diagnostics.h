@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _DIAGNOSTICS_H
+#define _DIAGNOSTICS_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstddef>
+
+/**
+Warnings that can come up for every sample of every record (or every
+pair of records).  Rather than printing each one, they're counted by
+kind, and a few examples of each are kept for a summary at the end.
+
+Safe to call from more than one thread at once.  The examples kept
+when running with threads may not be the first ones in the vcf.
+*/
+class Diagnostics
+{
+public:
+
+   enum Kind {SampleMissing = 0, AlleleNeverSeen, OverlapSkipped,
+              NumKinds};
+
+   /** how much to print.  Quiet: summary counts only.  Summary: counts
+    * and up to MaxExamples of each kind.  Verbose: every warning as
+    * it happens (and the counts) */
+   enum Verbosity {Quiet = 0, Summary, Verbose};
+
+   static const size_t MaxExamples = 5;
+
+   Diagnostics();
+   ~Diagnostics();
+
+   void setVerbosity(int verbosity);
+
+   /** count a warning.  returns true if it should be described with
+    * example() (so messages are only made when they'll be used) */
+   bool warn(Kind kind);
+
+   /** description of a warning that warn() returned true for */
+   void example(Kind kind, const std::string& message);
+
+   size_t getCount(Kind kind) const;
+
+   /** print counts (and any examples) of warnings so far, and forget
+    * them */
+   void report(std::ostream& os);
+
+protected:
+
+   int _verbosity;
+   std::vector<size_t> _counts;
+   std::vector<std::vector<std::string> > _examples;
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include <cassert>
+
+#include "genotyperow.h"
+
+using namespace std;
+
+GenotypeRow::GenotypeRow() : _numAlleles(0), _ploidy(1), _numWords(0),
+                             _numAbsent(0), _sampleNames(NULL)
+{
+}
+
+GenotypeRow::~GenotypeRow()
+{
+}
+
+void GenotypeRow::load(const GTRecord& rec)
+{
+  _numAlleles = rec.alleles.size();
+  _sampleNames = rec.sampleNames;
+  _ploidy = rec.ploidy;
+  _samplePloidy = rec.samplePloidy;
+  int numSamples = _samplePloidy.size();
+  _absent.assign((numSamples + 63) / 64, 0);
+  _numAbsent = 0;
+
+  for (int s = 0; s < numSamples; ++s)
+  {
+    if (_samplePloidy[s] == 0)
+    {
+      // SNPBridge warns about these
+      _absent[s / 64] |= (uint64_t)1 << (s % 64);
+      ++_numAbsent;
+    }
+  }
+
+  // set a bit for each haplotype in its allele's vector
+  _numWords = (rec.haplotypes.size() + 63) / 64;
+  _bits.assign((_numAlleles + 1) * _numWords, 0);
+  uint64_t* missing = _bits.data() + _numAlleles * _numWords;
+  for (size_t bit = 0; bit < rec.haplotypes.size(); ++bit)
+  {
+    int allele = rec.haplotypes[bit];
+    if (allele == GTRecord::Missing)
+    {
+      missing[bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+    else if (allele >= _numAlleles)
+    {
+      stringstream ss;
+      ss << "Sample " << getSampleName(bit / _ploidy) << " has GT allele "
+         << allele << " which is not present in " << rec;
+      throw runtime_error(ss.str());
+    }
+    else if (allele >= 0)
+    {
+      _bits[allele * _numWords + bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+  }
+}
+
+int GenotypeRow::getNumAlleles() const
+{
+  return _numAlleles;
+}
+
+int GenotypeRow::getNumSamples() const
+{
+  return _samplePloidy.size();
+}
+
+int GenotypeRow::getPloidy() const
+{
+  return _ploidy;
+}
+
+size_t GenotypeRow::getNumWords() const
+{
+  return _numWords;
+}
+
+const uint64_t* GenotypeRow::getAlleleBits(int i) const
+{
+  return _bits.data() + i * _numWords;
+}
+
+const uint64_t* GenotypeRow::getMissingBits() const
+{
+  return _bits.data() + _numAlleles * _numWords;
+}
+
+int GenotypeRow::getNumAbsent() const
+{
+  return _numAbsent;
+}
+
+const vector<uint64_t>& GenotypeRow::getAbsentBits() const
+{
+  return _absent;
+}
+
+int GenotypeRow::getSamplePloidy(int sample) const
+{
+  return _samplePloidy[sample];
+}
+
+const vector<unsigned char>& GenotypeRow::getSamplePloidies() const
+{
+  return _samplePloidy;
+}
+
+const string& GenotypeRow::getSampleName(int sample) const
+{
+  return (*_sampleNames)[sample];
+}
+
+GenotypeRowRing::GenotypeRowRing() : _rows(1), _numVariants(0)
+{
+}
+
+GenotypeRowRing::~GenotypeRowRing()
+{
+}
+
+void GenotypeRowRing::init(size_t capacity)
+{
+  assert(capacity > 0);
+  _rows.resize(capacity);
+  clear();
+}
+
+void GenotypeRowRing::clear()
+{
+  _numVariants = 0;
+}
+
+int64_t GenotypeRowRing::load(const GTRecord& rec)
+{
+  // the oldest row's buffers get reused
+  _rows[_numVariants % _rows.size()].load(rec);
+  return _numVariants++;
+}
+
+GenotypeRow& GenotypeRowRing::push()
+{
+  return _rows[_numVariants++ % _rows.size()];
+}
+
+int64_t GenotypeRowRing::getNumVariants() const
+{
+  return _numVariants;
+}
+
+bool GenotypeRowRing::hasRow(int64_t variant) const
+{
+  return variant >= 0 && variant < _numVariants &&
+     variant >= _numVariants - (int64_t)_rows.size();
+}
+
+const GenotypeRow& GenotypeRowRing::getRow(int64_t variant) const
+{
+  assert(hasRow(variant));
+  return _rows[variant % _rows.size()];
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _GENOTYPEROW_H
+#define _GENOTYPEROW_H
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <sstream>
+#include <cstdint>
+
+#include "gtreader.h"
+
+/**
+Genotypes of one vcf record, decoded once into bit vectors so that
+linkage between two records can be counted with AND + popcount
+instead of string parsing.
+
+Haplotype h of sample s gets bit (s * ploidy + h), following the
+layout of GTRecord::haplotypes.  For each allele there is a bit vector of
+the haplotypes that carry it, plus one extra vector marking haplotypes
+whose GT is . (wildcard).  Samples with no GT at all are flagged
+in a separate per-sample vector.
+*/
+
+class GenotypeRow
+{
+public:
+
+   GenotypeRow();
+   ~GenotypeRow();
+
+   /** decode the GT field of every sample in rec */
+   void load(const GTRecord& rec);
+
+   /** number of alleles, reference included */
+   int getNumAlleles() const;
+
+   /** number of samples (columns) */
+   int getNumSamples() const;
+
+   /** haplotype slots reserved for each sample */
+   int getPloidy() const;
+
+   /** number of 64-bit words in each haplotype bit vector */
+   size_t getNumWords() const;
+
+   /** haplotypes that carry allele i */
+   const uint64_t* getAlleleBits(int i) const;
+
+   /** haplotypes whose GT is . */
+   const uint64_t* getMissingBits() const;
+
+   /** number of samples with no GT in this row */
+   int getNumAbsent() const;
+
+   /** samples with no GT in this row (one bit per sample) */
+   const std::vector<uint64_t>& getAbsentBits() const;
+
+   /** ploidy of a given sample (0 if absent) */
+   int getSamplePloidy(int sample) const;
+
+   /** all sample ploidies, for quick comparison between rows */
+   const std::vector<unsigned char>& getSamplePloidies() const;
+
+   /** name of a sample */
+   const std::string& getSampleName(int sample) const;
+
+protected:
+
+   int _numAlleles;
+   int _ploidy;
+   size_t _numWords;
+   int _numAbsent;
+   const std::vector<std::string>* _sampleNames;
+
+   /** _numAlleles + 1 vectors of _numWords each.  last one is missing */
+   std::vector<uint64_t> _bits;
+   std::vector<uint64_t> _absent;
+   std::vector<unsigned char> _samplePloidy;
+};
+
+/**
+The most recent genotype rows of a sweep along the vcf, by variant
+number (0 for the first variant of a sequence).  Each record is
+decoded once, when it's read, and the row stays available to every
+pair that uses it until capacity more variants have been read.
+*/
+class GenotypeRowRing
+{
+public:
+
+   GenotypeRowRing();
+   ~GenotypeRowRing();
+
+   /** keep the last capacity rows, and forget all rows */
+   void init(size_t capacity);
+
+   /** forget all rows.  numbering starts again from 0 */
+   void clear();
+
+   /** decode rec as the next variant.  returns its number */
+   int64_t load(const GTRecord& rec);
+
+   /** make room for the next variant, and return its row to be loaded
+    * (perhaps by another thread, alongside other rows) */
+   GenotypeRow& push();
+
+   /** number of variants loaded since clear() */
+   int64_t getNumVariants() const;
+
+   /** is the row of a variant still here */
+   bool hasRow(int64_t variant) const;
+
+   /** row of a variant.  hasRow(variant) must be true */
+   const GenotypeRow& getRow(int64_t variant) const;
+
+protected:
+
+   std::vector<GenotypeRow> _rows;
+   int64_t _numVariants;
+};
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include "gfa.h"
+
+using namespace vg;
+using namespace std;
+
+GFAReader::GFAReader() : _lineNumber(0)
+{
+}
+
+GFAReader::~GFAReader()
+{
+  close();
+}
+
+void GFAReader::open(const string& path)
+{
+  close();
+  _path = path;
+  _file.open(path.c_str());
+  if (!_file.good())
+  {
+    throw runtime_error("Could not read " + path);
+  }
+  _lineNumber = 0;
+}
+
+void GFAReader::read(VG* vg)
+{
+  // segments, and links between segments already added, go in chunk.
+  // links to segments we haven't seen yet wait in pending
+  Graph chunk;
+  Graph pending;
+  Graph paths;
+  while (getline(_file, _line))
+  {
+    ++_lineNumber;
+    if (!_line.empty() && _line[_line.length() - 1] == '\r')
+    {
+      _line.resize(_line.length() - 1);
+    }
+    if (_line.empty())
+    {
+      continue;
+    }
+    switch (_line[0])
+    {
+    case 'S':
+      parseSegment(chunk);
+      break;
+    case 'L':
+      // so the graph knows about every segment read so far
+      if (chunk.node_size() > 0)
+      {
+        vg->extend(chunk);
+        chunk.Clear();
+      }
+      parseLink(vg, chunk, pending);
+      break;
+    case 'P':
+      parsePath(paths);
+      break;
+    default:
+      break;
+    }
+    if (chunk.node_size() + chunk.edge_size() >= ChunkSize)
+    {
+      vg->extend(chunk);
+      chunk.Clear();
+    }
+  }
+  if (_file.bad())
+  {
+    throw runtime_error("Error reading " + _path);
+  }
+  vg->extend(chunk);
+  vg->extend(pending);
+  vg->extend(paths);
+}
+
+void GFAReader::close()
+{
+  if (_file.is_open())
+  {
+    _file.close();
+  }
+}
+
+void GFAReader::splitLine()
+{
+  _fields.clear();
+  size_t start = 0;
+  for (size_t tab = _line.find('\t'); tab != string::npos;
+       tab = _line.find('\t', start))
+  {
+    _fields.push_back(_line.substr(start, tab - start));
+    start = tab + 1;
+  }
+  _fields.push_back(_line.substr(start));
+}
+
+int64_t GFAReader::parseId(const string& name)
+{
+  char* end = NULL;
+  long long id = strtoll(name.c_str(), &end, 10);
+  if (name.empty() || *end != '\0' || id <= 0)
+  {
+    throw lineError("Segment name " + name + " is not a node id");
+  }
+  return id;
+}
+
+void GFAReader::parseSegment(Graph& chunk)
+{
+  splitLine();
+  if (_fields.size() < 3)
+  {
+    throw lineError("Segment line needs a name and sequence");
+  }
+  if (_fields[2] == "*" || _fields[2].empty())
+  {
+    throw lineError("Segment " + _fields[1] + " has no sequence");
+  }
+  Node* node = chunk.add_node();
+  node->set_id(parseId(_fields[1]));
+  node->set_sequence(_fields[2]);
+}
+
+void GFAReader::parseLink(VG* vg, Graph& chunk, Graph& pending)
+{
+  splitLine();
+  if (_fields.size() < 5 ||
+      (_fields[2] != "+" && _fields[2] != "-") ||
+      (_fields[4] != "+" && _fields[4] != "-"))
+  {
+    throw lineError("Link line needs two segments and orientations");
+  }
+  if (_fields.size() > 5 && _fields[5] != "*" && _fields[5] != "0M" &&
+      !_fields[5].empty())
+  {
+    throw lineError("Overlapping links (" + _fields[5] +
+                    ") are not supported");
+  }
+  Edge edge;
+  edge.set_from(parseId(_fields[1]));
+  edge.set_from_start(_fields[2] == "-");
+  edge.set_to(parseId(_fields[3]));
+  edge.set_to_end(_fields[4] == "-");
+  if (vg->has_node(edge.from()) && vg->has_node(edge.to()))
+  {
+    // both ends are in: add it with the next chunk rather than hold
+    // on to it
+    *chunk.add_edge() = edge;
+  }
+  else
+  {
+    *pending.add_edge() = edge;
+  }
+}
+
+void GFAReader::parsePath(Graph& paths)
+{
+  splitLine();
+  if (_fields.size() < 3)
+  {
+    throw lineError("Path line needs a name and segments");
+  }
+  Path* path = paths.add_path();
+  path->set_name(_fields[1]);
+  const string& steps = _fields[2];
+  size_t start = 0;
+  while (start < steps.length())
+  {
+    size_t comma = steps.find(',', start);
+    if (comma == string::npos)
+    {
+      comma = steps.length();
+    }
+    char orient = steps[comma - 1];
+    if (comma - start < 2 || (orient != '+' && orient != '-'))
+    {
+      throw lineError("Path step " + steps.substr(start, comma - start) +
+                      " needs a segment and orientation");
+    }
+    Mapping* mapping = path->add_mapping();
+    mapping->mutable_position()->set_node_id(
+      parseId(steps.substr(start, comma - start - 1)));
+    mapping->mutable_position()->set_is_reverse(orient == '-');
+    mapping->set_rank(path->mapping_size());
+    start = comma + 1;
+  }
+}
+
+runtime_error GFAReader::lineError(const string& message) const
+{
+  stringstream ss;
+  ss << message << " at line " << _lineNumber << " of " << _path;
+  return runtime_error(ss.str());
+}
+
+GFAWriter::GFAWriter()
+{
+}
+
+GFAWriter::~GFAWriter()
+{
+}
+
+void GFAWriter::open(ostream* out)
+{
+  _out = out;
+  _steps.clear();
+  _pathNames.clear();
+  *_out << "H\tVN:Z:1.0\n";
+}
+
+void GFAWriter::writeChunk(const Graph& chunk)
+{
+  for (int i = 0; i < chunk.node_size(); ++i)
+  {
+    const Node& node = chunk.node(i);
+    *_out << "S\t" << node.id() << '\t' << node.sequence() << '\n';
+  }
+  for (int i = 0; i < chunk.edge_size(); ++i)
+  {
+    const Edge& edge = chunk.edge(i);
+    *_out << "L\t" << edge.from() << '\t' << orientation(edge.from_start())
+          << '\t' << edge.to() << '\t' << orientation(edge.to_end())
+          << "\t0M\n";
+  }
+  for (int i = 0; i < chunk.path_size(); ++i)
+  {
+    const Path& path = chunk.path(i);
+    if (_steps.find(path.name()) == _steps.end())
+    {
+      _pathNames.push_back(path.name());
+    }
+    vector<pair<int64_t, bool> >& steps = _steps[path.name()];
+    for (int j = 0; j < path.mapping_size(); ++j)
+    {
+      const Position& position = path.mapping(j).position();
+      steps.push_back(make_pair(position.node_id(), position.is_reverse()));
+    }
+  }
+  if (!_out->good())
+  {
+    throw runtime_error("Error writing graph");
+  }
+}
+
+void GFAWriter::writeChunkData(const string& data)
+{
+  _chunk.Clear();
+  if (!data.empty() && !_chunk.ParseFromString(data))
+  {
+    throw runtime_error("Error reading graph chunk");
+  }
+  writeChunk(_chunk);
+}
+
+void GFAWriter::close()
+{
+  if (_out == NULL)
+  {
+    return;
+  }
+  for (auto& name : _pathNames)
+  {
+    *_out << "P\t" << name << '\t';
+    vector<pair<int64_t, bool> >& steps = _steps[name];
+    for (size_t i = 0; i < steps.size(); ++i)
+    {
+      *_out << (i > 0 ? "," : "") << steps[i].first
+            << orientation(steps[i].second);
+    }
+    *_out << "\t*\n";
+  }
+  _out->flush();
+  bool good = _out->good();
+  _out = NULL;
+  _steps.clear();
+  _pathNames.clear();
+  if (!good)
+  {
+    throw runtime_error("Error writing graph");
+  }
+}
+
+char GFAWriter::orientation(bool reverse)
+{
+  return reverse ? '-' : '+';
+}
+
+bool isGFA(const string& path)
+{
+  return path.length() > 4 &&
+     path.compare(path.length() - 4, 4, ".gfa") == 0;
+}
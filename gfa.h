@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _GFA_H
+#define _GFA_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <stdexcept>
+#include <sstream>
+#include <cstdint>
+
+#include "vg/src/vg.hpp"
+#include "graphwindow.h"
+
+/**
+Read a GFA (version 1) file straight into a vg graph, a line at a
+time.  Segments (S) become nodes, links (L) edges and paths (P) vg
+paths of whole-node mappings.  Segment names must be (positive) node
+ids, and links can't overlap (0M or *), since vg has no way to say
+otherwise.  Other lines (H, C, comments) are skipped.
+
+Nodes are added to the graph in chunks, as they're read, so the
+file is never held in memory as a whole.  Links are added as soon as
+both their segments have been, and paths once the whole file is read.
+*/
+class GFAReader
+{
+public:
+
+   /** number of segments added to the graph at once */
+   static const int ChunkSize = 1000;
+
+   GFAReader();
+   ~GFAReader();
+
+   /** open file.  throws runtime_error on failure */
+   void open(const std::string& path);
+
+   /** add everything in the file to vg.  throws runtime_error on a
+    * line we can't read */
+   void read(vg::VG* vg);
+
+   void close();
+
+protected:
+
+   /** split _line on tabs into _fields */
+   void splitLine();
+
+   /** node id from a segment name */
+   int64_t parseId(const std::string& name);
+
+   void parseSegment(vg::Graph& chunk);
+   /** the link goes in chunk if both its segments are in vg, and
+    * pending if not */
+   void parseLink(vg::VG* vg, vg::Graph& chunk, vg::Graph& pending);
+   void parsePath(vg::Graph& paths);
+
+   /** exception about the current line */
+   std::runtime_error lineError(const std::string& message) const;
+
+protected:
+
+   std::string _path;
+   std::ifstream _file;
+   std::string _line;
+   std::vector<std::string> _fields;
+   long _lineNumber;
+};
+
+/**
+Write graph chunks as GFA (version 1) instead of vg protobuf: a
+segment (S) line per node and a link (L) line per edge, written as
+soon as each chunk is.  A GFA path (P) line has to list all of the
+path's steps at once, so the steps are kept (as ids and orientations
+only) and the P lines written by close().  Mapping edits are not
+written: paths are taken to cover their nodes completely, as they do
+in graphs made by vg construct.
+*/
+class GFAWriter : public GraphChunkWriter
+{
+public:
+   GFAWriter();
+   virtual ~GFAWriter();
+
+   /** write the header */
+   virtual void open(std::ostream* out);
+
+   virtual void writeChunk(const vg::Graph& chunk);
+
+   /** parses the chunk and writes it as GFA */
+   virtual void writeChunkData(const std::string& data);
+
+   /** write the P lines */
+   virtual void close();
+
+protected:
+
+   /** GFA orientation of a step or link end */
+   static char orientation(bool reverse);
+
+protected:
+
+   /** steps of each path, by node id and reverse flag */
+   std::map<std::string, std::vector<std::pair<int64_t, bool> > > _steps;
+   /** path names in the order they were first seen */
+   std::vector<std::string> _pathNames;
+   vg::Graph _chunk;
+};
+
+/** does a file name end in .gfa */
+bool isGFA(const std::string& path);
+
+#endif
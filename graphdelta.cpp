@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include <cstring>
+#include <unistd.h>
+
+#include "graphdelta.h"
+#include "graphedits.h"
+
+using namespace vg;
+using namespace std;
+
+static const char DeltaMagic[] = "SNPBDLTA";
+static const int DeltaMagicLength = 8;
+static const char DeltaVersion = 1;
+
+GraphDeltaWriter::GraphDeltaWriter() : _lastId(0)
+{
+}
+
+GraphDeltaWriter::~GraphDeltaWriter()
+{
+  close();
+}
+
+void GraphDeltaWriter::open(const string& path)
+{
+  _path = path;
+  _file.open(path.c_str(), ios::binary | ios::trunc);
+  if (!_file.good())
+  {
+    throw runtime_error("Could not write " + path);
+  }
+  _file.write(DeltaMagic, DeltaMagicLength);
+  _file.put(DeltaVersion);
+  _lastId = 0;
+}
+
+void GraphDeltaWriter::reopen(const string& path, int64_t length,
+                              int64_t lastId)
+{
+  _path = path;
+  if (truncate(path.c_str(), length) != 0)
+  {
+    throw runtime_error("Could not truncate " + path);
+  }
+  _file.open(path.c_str(), ios::binary | ios::in | ios::out);
+  _file.seekp(length);
+  if (!_file.good())
+  {
+    throw runtime_error("Could not write " + path);
+  }
+  _lastId = lastId;
+}
+
+int64_t GraphDeltaWriter::tell()
+{
+  _file.flush();
+  check();
+  return _file.tellp();
+}
+
+int64_t GraphDeltaWriter::getLastId() const
+{
+  return _lastId;
+}
+
+void GraphDeltaWriter::writeDestroyEdge(const NodeSide& side1,
+                                        const NodeSide& side2)
+{
+  _file.put((char)GraphDeltaReader::Record::DestroyEdge);
+  writeSide(side1);
+  writeSide(side2);
+  check();
+}
+
+void GraphDeltaWriter::writeNode(const Node& node)
+{
+  _file.put((char)GraphDeltaReader::Record::CreateNode);
+  writeId(node.id());
+  writeVarint(node.sequence().length());
+  _file.write(node.sequence().data(), node.sequence().length());
+  check();
+}
+
+void GraphDeltaWriter::writeEdge(const Edge& edge)
+{
+  // GraphEdits only makes edges from end to start
+  assert(!edge.from_start() && !edge.to_end());
+  _file.put((char)GraphDeltaReader::Record::CreateEdge);
+  writeId(edge.from());
+  writeId(edge.to());
+  check();
+}
+
+void GraphDeltaWriter::close()
+{
+  if (_file.is_open())
+  {
+    _file.close();
+  }
+}
+
+void GraphDeltaWriter::writeVarint(uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    _file.put((char)(v | 0x80));
+    v >>= 7;
+  }
+  _file.put((char)v);
+}
+
+void GraphDeltaWriter::writeId(int64_t id)
+{
+  int64_t delta = id - _lastId;
+  writeVarint(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+  _lastId = id;
+}
+
+void GraphDeltaWriter::writeSide(const NodeSide& side)
+{
+  writeId(side.node);
+  _file.put(side.is_end ? 1 : 0);
+}
+
+void GraphDeltaWriter::check()
+{
+  if (!_file.good())
+  {
+    throw runtime_error("Error writing " + _path);
+  }
+}
+
+GraphDeltaReader::GraphDeltaReader() : _lastId(0)
+{
+}
+
+GraphDeltaReader::~GraphDeltaReader()
+{
+}
+
+void GraphDeltaReader::open(const string& path)
+{
+  _path = path;
+  _file.open(path.c_str(), ios::binary);
+  char magic[DeltaMagicLength];
+  if (!_file.good() || !_file.read(magic, DeltaMagicLength) ||
+      memcmp(magic, DeltaMagic, DeltaMagicLength) != 0)
+  {
+    throw runtime_error("Could not read graph delta from " + path);
+  }
+  if (_file.get() != DeltaVersion)
+  {
+    throw runtime_error("Unsupported graph delta version in " + path);
+  }
+  _lastId = 0;
+}
+
+bool GraphDeltaReader::readRecord(Record& record)
+{
+  int kind = _file.get();
+  if (kind == EOF)
+  {
+    return false;
+  }
+  record.kind = (Record::Kind)kind;
+  switch (kind)
+  {
+  case Record::DestroyEdge:
+    readSide(record.side1);
+    readSide(record.side2);
+    break;
+  case Record::CreateNode:
+  {
+    record.node.set_id(readId());
+    string* sequence = record.node.mutable_sequence();
+    sequence->resize(readVarint());
+    if (!sequence->empty())
+    {
+      _file.read(&(*sequence)[0], sequence->length());
+    }
+    break;
+  }
+  case Record::CreateEdge:
+    record.side1 = NodeSide(readId(), true);
+    record.side2 = NodeSide(readId(), false);
+    break;
+  default:
+  {
+    stringstream ss;
+    ss << "Unknown edit " << kind << " in graph delta " << _path;
+    throw runtime_error(ss.str());
+  }
+  }
+  if (!_file.good())
+  {
+    throw runtime_error("Truncated graph delta " + _path);
+  }
+  return true;
+}
+
+void GraphDeltaReader::apply(VG* vg)
+{
+  // edits from one batch can undo those from an earlier one (an edge
+  // made, then destroyed for the next bridge).  GraphEdits nets them
+  // out, as long as they go in in order
+  GraphEdits edits;
+  edits.init(vg);
+  Record record;
+  while (readRecord(record))
+  {
+    switch (record.kind)
+    {
+    case Record::DestroyEdge:
+      if (!edits.hasEdge(record.side1, record.side2))
+      {
+        stringstream ss;
+        ss << "Edge to destroy between " << record.side1.node << " and "
+           << record.side2.node << " not found in graph: was " << _path
+           << " made from it?";
+        throw runtime_error(ss.str());
+      }
+      edits.destroyEdge(record.side1, record.side2);
+      break;
+    case Record::CreateNode:
+      if (vg->has_node(record.node.id()))
+      {
+        stringstream ss;
+        ss << "Node " << record.node.id() << " from " << _path
+           << " is already in graph";
+        throw runtime_error(ss.str());
+      }
+      edits.createNode(record.node.sequence(), record.node.id());
+      break;
+    case Record::CreateEdge:
+      edits.createEdge(record.side1.node, record.side2.node);
+      break;
+    }
+  }
+  edits.apply();
+}
+
+uint64_t GraphDeltaReader::readVarint()
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    int c = _file.get();
+    if (c == EOF)
+    {
+      throw runtime_error("Truncated graph delta " + _path);
+    }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if ((c & 0x80) == 0)
+    {
+      break;
+    }
+  }
+  return v;
+}
+
+int64_t GraphDeltaReader::readId()
+{
+  uint64_t v = readVarint();
+  _lastId += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  return _lastId;
+}
+
+void GraphDeltaReader::readSide(NodeSide& side)
+{
+  side.node = readId();
+  side.is_end = _file.get() == 1;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _GRAPHDELTA_H
+#define _GRAPHDELTA_H
+
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+
+#include "vg/src/vg.hpp"
+
+/**
+A graph delta is the list of edits bridging made to a graph: edges
+destroyed, nodes created (with their sequences) and edges created.
+Bridging only touches a small part of the graph, so the delta is
+tiny next to the graph, and applying it to the original graph gives
+the same graph as writing it out in full.
+
+Binary format: "SNPBDLTA", a version byte, then one record per edit,
+in the order they were made:
+  kind byte (see Record::Kind)
+  DestroyEdge: the two sides of the edge, each a node id and an is_end
+               byte
+  CreateNode:  node id, sequence length, sequence
+  CreateEdge:  from node id, to node id (end of from to start of to)
+Node ids are written as the zigzag-encoded difference from the last
+id in the file, since bridge nodes are numbered consecutively.  All
+integers are unsigned LEB128 varints.
+*/
+
+class GraphDeltaWriter
+{
+public:
+   GraphDeltaWriter();
+   ~GraphDeltaWriter();
+
+   /** create file and write header. throws runtime_error on failure */
+   void open(const std::string& path);
+
+   /** open a file written before to add more edits, dropping anything
+    * after its first length bytes (from tell()).  lastId is what
+    * getLastId() returned at that point.  throws runtime_error on
+    * failure */
+   void reopen(const std::string& path, int64_t length, int64_t lastId);
+
+   /** flush the edits written so far, and return the file's length */
+   int64_t tell();
+
+   /** last node id written, which the next one is written relative to */
+   int64_t getLastId() const;
+
+   void writeDestroyEdge(const vg::NodeSide& side1,
+                         const vg::NodeSide& side2);
+   void writeNode(const vg::Node& node);
+   void writeEdge(const vg::Edge& edge);
+
+   void close();
+
+protected:
+
+   void writeVarint(uint64_t v);
+   void writeId(int64_t id);
+   void writeSide(const vg::NodeSide& side);
+   void check();
+
+protected:
+
+   std::string _path;
+   std::ofstream _file;
+   int64_t _lastId;
+};
+
+class GraphDeltaReader
+{
+public:
+
+   /** one edit from the file */
+   struct Record
+   {
+      enum Kind {DestroyEdge = 1, CreateNode, CreateEdge};
+      Kind kind;
+      /** the edge's sides for DestroyEdge, or from's end and to's
+       * start for CreateEdge */
+      vg::NodeSide side1;
+      vg::NodeSide side2;
+      /** the new node for CreateNode */
+      vg::Node node;
+   };
+
+   GraphDeltaReader();
+   ~GraphDeltaReader();
+
+   /** open file and check header. throws runtime_error on failure */
+   void open(const std::string& path);
+
+   /** read the next edit.  returns false at end of file */
+   bool readRecord(Record& record);
+
+   /** make all the (remaining) edits in the file in vg, which must be
+    * the graph the delta was made from.  they're logged in a
+    * GraphEdits and applied at once, with one index rebuild */
+   void apply(vg::VG* vg);
+
+protected:
+
+   uint64_t readVarint();
+   int64_t readId();
+   void readSide(vg::NodeSide& side);
+
+protected:
+
+   std::string _path;
+   std::ifstream _file;
+   int64_t _lastId;
+};
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include "graphedits.h"
+#include "graphdelta.h"
+
+using namespace vg;
+using namespace std;
+
+GraphEdits::GraphEdits() : _vg(NULL), _delta(NULL), _nextId(0)
+{
+}
+
+GraphEdits::~GraphEdits()
+{
+}
+
+void GraphEdits::init(VG* vg)
+{
+  _vg = vg;
+  _nextId = 0;
+  _deleted.clear();
+  _newNodes.clear();
+  _newEdges.clear();
+  _newOnEnd.clear();
+  _newOnStart.clear();
+}
+
+void GraphEdits::setDeltaWriter(GraphDeltaWriter* delta)
+{
+  _delta = delta;
+}
+
+int64_t GraphEdits::newNodeId()
+{
+  if (_nextId == 0)
+  {
+    _nextId = _vg->max_node_id() + 1;
+  }
+  return _nextId++;
+}
+
+int64_t GraphEdits::createNode(const string& sequence, int64_t id)
+{
+  if (id == 0)
+  {
+    id = newNodeId();
+  }
+  _newNodes.push_back(Node());
+  _newNodes.back().set_id(id);
+  _newNodes.back().set_sequence(sequence);
+  return id;
+}
+
+void GraphEdits::createEdge(int64_t from, int64_t to)
+{
+  NodeSide side1(from, true);
+  NodeSide side2(to, false);
+  Sides sides = edgeSides(side1, side2);
+
+  // putting back an edge we took out of the graph
+  set<Sides>::iterator i = _deleted.find(sides);
+  if (i != _deleted.end())
+  {
+    _deleted.erase(i);
+    return;
+  }
+  if (hasEdge(side1, side2))
+  {
+    return;
+  }
+  Edge& edge = _newEdges[sides];
+  edge.set_from(from);
+  edge.set_to(to);
+  _newOnEnd[from].push_back(make_pair(to, false));
+  _newOnStart[to].push_back(make_pair(from, false));
+}
+
+void GraphEdits::destroyEdge(const NodeSide& side1, const NodeSide& side2)
+{
+  Sides sides = edgeSides(side1, side2);
+  map<Sides, Edge>::iterator i = _newEdges.find(sides);
+  if (i != _newEdges.end())
+  {
+    // never made it into the graph: just forget about it
+    int64_t from = i->second.from();
+    int64_t to = i->second.to();
+    eraseAdjacency(_newOnEnd, from, make_pair(to, false));
+    eraseAdjacency(_newOnStart, to, make_pair(from, false));
+    _newEdges.erase(i);
+  }
+  else if (_vg->has_edge(side1, side2))
+  {
+    _deleted.insert(sides);
+  }
+}
+
+bool GraphEdits::hasEdge(const NodeSide& side1, const NodeSide& side2) const
+{
+  Sides sides = edgeSides(side1, side2);
+  if (_newEdges.find(sides) != _newEdges.end())
+  {
+    return true;
+  }
+  if (_deleted.find(sides) != _deleted.end())
+  {
+    return false;
+  }
+  return _vg->has_edge(side1, side2);
+}
+
+void GraphEdits::edgesOnEnd(int64_t id,
+                            vector<pair<int64_t, bool> >& outEdges) const
+{
+  outEdges.clear();
+  // vg's map type is its own business
+  auto i = _vg->edges_on_end.find(id);
+  if (i != _vg->edges_on_end.end())
+  {
+    for (auto p : i->second)
+    {
+      if (_deleted.empty() || _deleted.find(
+            edgeSides(NodeSide(id, true), NodeSide(p.first, p.second))) ==
+          _deleted.end())
+      {
+        outEdges.push_back(p);
+      }
+    }
+  }
+  AdjacencyMap::const_iterator j = _newOnEnd.find(id);
+  if (j != _newOnEnd.end())
+  {
+    outEdges.insert(outEdges.end(), j->second.begin(), j->second.end());
+  }
+}
+
+void GraphEdits::edgesOnStart(int64_t id,
+                              vector<pair<int64_t, bool> >& outEdges) const
+{
+  outEdges.clear();
+  // vg's map type is its own business
+  auto i = _vg->edges_on_start.find(id);
+  if (i != _vg->edges_on_start.end())
+  {
+    for (auto p : i->second)
+    {
+      if (_deleted.empty() || _deleted.find(
+            edgeSides(NodeSide(p.first, !p.second), NodeSide(id, false))) ==
+          _deleted.end())
+      {
+        outEdges.push_back(p);
+      }
+    }
+  }
+  AdjacencyMap::const_iterator j = _newOnStart.find(id);
+  if (j != _newOnStart.end())
+  {
+    outEdges.insert(outEdges.end(), j->second.begin(), j->second.end());
+  }
+}
+
+size_t GraphEdits::size() const
+{
+  return _deleted.size() + _newNodes.size() + _newEdges.size();
+}
+
+size_t GraphEdits::getNumNewNodes() const
+{
+  return _newNodes.size();
+}
+
+size_t GraphEdits::getNumNewEdges() const
+{
+  return _newEdges.size();
+}
+
+size_t GraphEdits::getNumDeletedEdges() const
+{
+  return _deleted.size();
+}
+
+bool GraphEdits::isFull() const
+{
+  // an apply costs a pass over the graph, so don't do it more often
+  // than it takes to double the edges
+  size_t threshold = _vg->graph.edge_size() / 2;
+  if (threshold < MinBatchSize)
+  {
+    threshold = MinBatchSize;
+  }
+  return size() >= threshold;
+}
+
+void GraphEdits::apply()
+{
+  if (size() == 0)
+  {
+    return;
+  }
+
+  if (_delta != NULL)
+  {
+    // in the same order they're made below
+    for (auto& sides : _deleted)
+    {
+      _delta->writeDestroyEdge(sides.first, sides.second);
+    }
+    for (auto& node : _newNodes)
+    {
+      _delta->writeNode(node);
+    }
+    for (auto& edge : _newEdges)
+    {
+      _delta->writeEdge(edge.second);
+    }
+  }
+
+  if (!_deleted.empty())
+  {
+    google::protobuf::RepeatedPtrField<Edge>* edges =
+       _vg->graph.mutable_edge();
+    for (int i = edges->size() - 1; i >= 0; --i)
+    {
+      if (_deleted.find(edgeSides(edges->Get(i))) != _deleted.end())
+      {
+        edges->SwapElements(i, edges->size() - 1);
+        edges->RemoveLast();
+      }
+    }
+  }
+  for (auto& node : _newNodes)
+  {
+    *_vg->graph.add_node() = node;
+  }
+  for (auto& edge : _newEdges)
+  {
+    *_vg->graph.add_edge() = edge.second;
+  }
+
+  _vg->rebuild_indexes();
+
+  _deleted.clear();
+  _newNodes.clear();
+  _newEdges.clear();
+  _newOnEnd.clear();
+  _newOnStart.clear();
+}
+
+pair<NodeSide, NodeSide> GraphEdits::edgeSides(const Edge& edge)
+{
+  return edgeSides(NodeSide(edge.from(), !edge.from_start()),
+                   NodeSide(edge.to(), edge.to_end()));
+}
+
+pair<NodeSide, NodeSide> GraphEdits::edgeSides(const NodeSide& side1,
+                                               const NodeSide& side2)
+{
+  return side2 < side1 ? make_pair(side2, side1) : make_pair(side1, side2);
+}
+
+void GraphEdits::eraseAdjacency(AdjacencyMap& adjacencies, int64_t id,
+                                const pair<int64_t, bool>& other)
+{
+  AdjacencyMap::iterator i = adjacencies.find(id);
+  if (i != adjacencies.end())
+  {
+    vector<pair<int64_t, bool> >::iterator j =
+       find(i->second.begin(), i->second.end(), other);
+    if (j != i->second.end())
+    {
+      i->second.erase(j);
+    }
+  }
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _GRAPHEDITS_H
+#define _GRAPHEDITS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+
+#include "vg/src/vg.hpp"
+
+class GraphDeltaWriter;
+
+/**
+Log of edge deletions, node insertions and edge insertions to make
+in a graph.  Every create/destroy in vg updates its edge indexes, and
+in dense regions those updates cost more than anything else.  So we
+record the edits here instead, and apply them all at once with one
+pass over the edges and one index rebuild.
+
+Until then, edgesOnEnd() and edgesOnStart() give the adjacencies of
+the graph as if the edits had been applied.  Nodes are referred to by
+id, since the new ones don't exist in the graph yet.  Edges are all
+from the end of one node to the start of another (or given by their
+two sides).
+*/
+class GraphEdits
+{
+public:
+
+   /** apply automatically once there are at least this many edits */
+   static const size_t MinBatchSize = 4096;
+
+   GraphEdits();
+   ~GraphEdits();
+
+   /** start logging edits for a graph */
+   void init(vg::VG* vg);
+
+   /** also write every batch of edits to delta as it's applied (NULL
+    * to stop) */
+   void setDeltaWriter(GraphDeltaWriter* delta);
+
+   /** id for a new node, after the largest in the graph */
+   int64_t newNodeId();
+
+   /** add a node.  if id is 0, one is made with newNodeId() */
+   int64_t createNode(const std::string& sequence, int64_t id = 0);
+
+   /** add an edge from end of node from to start of node to */
+   void createEdge(int64_t from, int64_t to);
+
+   /** remove the edge between two sides (if it's there) */
+   void destroyEdge(const vg::NodeSide& side1, const vg::NodeSide& side2);
+
+   /** is there an edge between two sides (edits included) */
+   bool hasEdge(const vg::NodeSide& side1, const vg::NodeSide& side2) const;
+
+   /** edges on end of node, in vg::VG::edges_on_end format */
+   void edgesOnEnd(int64_t id,
+                   std::vector<std::pair<int64_t, bool> >& outEdges) const;
+
+   /** edges on start of node, in vg::VG::edges_on_start format */
+   void edgesOnStart(int64_t id,
+                     std::vector<std::pair<int64_t, bool> >& outEdges) const;
+
+   /** number of edits waiting */
+   size_t size() const;
+
+   /** number of waiting edits of each kind */
+   size_t getNumNewNodes() const;
+   size_t getNumNewEdges() const;
+   size_t getNumDeletedEdges() const;
+
+   /** are there enough edits waiting that they should be applied */
+   bool isFull() const;
+
+   /** make all the edits in the graph */
+   void apply();
+
+   /** both sides of an edge, smallest first */
+   static std::pair<vg::NodeSide, vg::NodeSide> edgeSides(
+     const vg::Edge& edge);
+
+   static std::pair<vg::NodeSide, vg::NodeSide> edgeSides(
+     const vg::NodeSide& side1, const vg::NodeSide& side2);
+
+protected:
+
+   typedef std::pair<vg::NodeSide, vg::NodeSide> Sides;
+   typedef std::unordered_map<int64_t,
+                              std::vector<std::pair<int64_t, bool> > >
+   AdjacencyMap;
+
+   /** remove one item from an adjacency list */
+   static void eraseAdjacency(AdjacencyMap& adjacencies, int64_t id,
+                              const std::pair<int64_t, bool>& other);
+
+protected:
+
+   vg::VG* _vg;
+   GraphDeltaWriter* _delta;
+   int64_t _nextId;
+
+   /** edges of the graph that are to be removed */
+   std::set<Sides> _deleted;
+   std::vector<vg::Node> _newNodes;
+   std::map<Sides, vg::Edge> _newEdges;
+   /** _newEdges indexed like vg's edges_on_end / edges_on_start */
+   AdjacencyMap _newOnEnd;
+   AdjacencyMap _newOnStart;
+};
+
+#endif
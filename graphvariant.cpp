@@ -5,12 +5,11 @@
  */
 #include "graphvariant.h"
 
-using namespace vcflib;
 using namespace vg;
 using namespace std;
 
-GraphVariant::GraphVariant() : _vg(NULL), _path(NULL), _refIdx(-1),
-                               _vcf(NULL), _offset(0), _cat(REFONLY)
+GraphVariant::GraphVariant() : _vg(NULL), _path(NULL), _rank(-1),
+                               _offset(0), _cat(REFONLY)
 {
 }
 
@@ -18,65 +17,45 @@ GraphVariant::~GraphVariant()
 {
 }
 
-void GraphVariant::init(int offset)
+void GraphVariant::init(const PathIndex* path, int offset)
 {
   _vg = NULL;
-  _path = NULL;
-  _refIdx = -1;
-  _vcf = NULL;
+  _path = path;
+  _rank = -1;
   _offset = offset;
 }
 
-void GraphVariant::loadVariant(VG* vg, Variant& var)
+void GraphVariant::loadVariant(VG* vg, const VCFSite& var)
 {
   _vg = vg;
   _var = var;
   _cat = varCat(var);
-  
-  // no path, let's find it and start at the beginning
-  if (_path == NULL || _refIdx < 0)
-  {
-    if (_vg->paths.has_path(var.sequenceName) == false)
-    {
-      stringstream ss;
-      ss << "Unable to find path for " << var.sequenceName << " in vg file";
-      throw runtime_error(ss.str());
-    }
-    _path = &_vg->paths.get_path(var.sequenceName);
-    _mappingIt = _path->begin();
-    _refIdx = 0;
-  }
 
-  // scan forward in vg along path until are variant reference falls within
-  // a mapping
-  int mappingLen = -1;
-  int vcfPos = var.position - _offset;
-  for (; _mappingIt != _path->end(); ++_mappingIt, _refIdx += mappingLen)
+  // upper case the alleles once, so they can be compared to node
+  // sequences with memcmp
+  _upperAlleles.resize(var.alleles.size());
+  for (size_t i = 0; i < var.alleles.size(); ++i)
   {
-    if (_mappingIt->position().is_reverse() == true)
+    string& upper = _upperAlleles[i];
+    upper.assign(var.alleles[i]);
+    for (auto& c : upper)
     {
-      throw(runtime_error("Reverse Mapping not supported"));
+      c = toupper(c);
     }
-    if (_mappingIt->edit_size() > 1 || (
-          _mappingIt->edit_size() == 1 && _mappingIt->edit(0).from_length() !=
-          _mappingIt->edit(0).to_length()))
-    {
-      stringstream ss;
-      ss << pb2json(*_mappingIt) << ": Only mappings with a single trvial edit"
-         << " supported in ref path";
-      throw runtime_error(ss.str());
-    }
-
-    mappingLen =
-       _vg->get_node(_mappingIt->position().node_id())->sequence().length();
+  }
   
-    if (_refIdx + mappingLen > vcfPos)
-    {
-      break;
-    }
+  if (var.sequenceName != _path->getName())
+  {
+    stringstream ss;
+    ss << "Unable to find path for " << var.sequenceName << " in vg file";
+    throw runtime_error(ss.str());
   }
 
-  if (mappingLen < 1 || vcfPos < _refIdx || vcfPos >= _refIdx + mappingLen)
+  // binary search for the node containing our variant
+  int vcfPos = var.position - _offset;
+  _rank = _path->find(vcfPos);
+
+  if (_rank < 0)
   {
     stringstream ss;
     ss << "Variant at position " << var.sequenceName << ":" << var.position
@@ -89,10 +68,55 @@ void GraphVariant::loadVariant(VG* vg, Variant& var)
   loadAlleles();
 }
 
+void GraphVariant::loadVariant(VG* vg, const VCFSite& var,
+                               const vector<vector<int64_t> >& alleleIds)
+{
+  _vg = vg;
+  _var = var;
+  _cat = varCat(var);
+  _rank = _path->find(var.position - _offset);
+  if (_rank < 0 || alleleIds.size() != var.alleles.size())
+  {
+    stringstream ss;
+    ss << "Variant at position " << var.sequenceName << ":" << var.position
+       << " not found in graph";
+    throw runtime_error(ss.str());
+  }
+  _graphAlleles.resize(alleleIds.size());
+  for (size_t i = 0; i < alleleIds.size(); ++i)
+  {
+    _graphAlleles[i].clear();
+    for (auto id : alleleIds[i])
+    {
+      if (!vg->has_node(id))
+      {
+        stringstream ss;
+        ss << "Node " << id << " of allele " << i << " of " << var
+           << " not found in graph";
+        throw runtime_error(ss.str());
+      }
+      _graphAlleles[i].push_back(vg->get_node(id));
+    }
+  }
+}
+
+void GraphVariant::getAlleleIds(vector<vector<int64_t> >& outIds) const
+{
+  outIds.resize(_graphAlleles.size());
+  for (size_t i = 0; i < _graphAlleles.size(); ++i)
+  {
+    outIds[i].clear();
+    for (auto node : _graphAlleles[i])
+    {
+      outIds[i].push_back(node->id());
+    }
+  }
+}
+
 void GraphVariant::loadAlleles()
 {
 #ifdef DEBUG
-  cerr << "1st vg ref node " << _mappingIt->position().node_id()
+  cerr << "1st vg ref node " << _path->getNode(_rank)->id()
        << " _var position " << _var.position << " ref "
        << _var.alleles[0] << endl;
 #endif
@@ -104,17 +128,25 @@ void GraphVariant::loadAlleles()
   // find path in the graph corresponding to reference allele
   // because we assume vg construct -f used, the allele shouold
   // be exactly represented by a path (with no offsets)
-  string vgRefPath;
-  std::list<vg::Mapping>::const_iterator it = _mappingIt;
-  for (; vgRefPath.length() < _var.alleles[0].length() &&
-          it != _path->end(); ++it)
+  const string& refAllele = _upperAlleles[0];
+  size_t refLength = 0;
+  bool refMatches = true;
+  for (size_t rank = _rank; refLength < refAllele.length() &&
+          rank < _path->getNumNodes(); ++rank)
   {
-    Node* node =  _vg->get_node(it->position().node_id());
-    vgRefPath += node->sequence();
+    Node* node = _path->getNode(rank);
+    refMatches = refMatches &&
+       matchesAt(refAllele, refLength, node->sequence());
+    refLength += node->sequence().length();
     _graphAlleles[0].push_back(node);
   }
-  if (!istreq(vgRefPath, _var.alleles[0]))
+  if (!refMatches || refLength != refAllele.length())
   {
+    string vgRefPath;
+    for (auto node : _graphAlleles[0])
+    {
+      vgRefPath += node->sequence();
+    }
     stringstream ss;
     ss << "vg path beginning at node " << _graphAlleles[0].front()->id()
        << " has sequence " << vgRefPath << " which does not "
@@ -134,31 +166,26 @@ void GraphVariant::loadAlleles()
   
   // now, our variants will be in the set of siblings
   // (nodes that share neighbouring sides on both ends
-  // as our reference)  
-  set<NodeTraversal> toSibs = _vg->full_siblings_to(_graphAlleles[0].front());
-  set<NodeTraversal> fromSibs = _vg->full_siblings_from(_graphAlleles[0].back());
-  set<NodeTraversal> sibs;
-
-  //set_intersection(toSibs.begin(), toSibs.end(),
-  //                 fromSibs.begin(), fromSibs.end(), sibs.begin());
-  // Weird: above won't compile.  just brute force it
-  for (auto& nt : toSibs)
-  {
-    if (fromSibs.find(nt) != fromSibs.end())
-    {
-      sibs.insert(nt);
-    }
-  }
+  // as our reference).  the path index has the ones that share
+  // the way in, and we check the way out
+  size_t firstAlt = 0;
+  size_t lastAlt = 0;
+  _path->getAlts(_rank, firstAlt, lastAlt);
+  size_t lastRank = _rank + _graphAlleles[0].size() - 1;
       
   // search siblings for remaining alleles.  expecting exact mathc
   // of vg node to vcf allele
   for (int i = 1; i < _var.alleles.size(); ++i)
   {
-    for (auto& nt : sibs)
+    const string& allele = _upperAlleles[i];
+    for (size_t j = firstAlt; j < lastAlt; ++j)
     {
-      if (istreq(_var.alleles[i], nt.node->sequence()))
+      Node* node = _path->getAltNode(j);
+      if (node->sequence().length() == allele.length() &&
+          _path->altEndsAt(j, lastRank) &&
+          matchesAt(allele, 0, node->sequence()))
       {
-        _graphAlleles.push_back(list<Node*>(1, nt.node));
+        _graphAlleles.push_back(list<Node*>(1, node));
       }
     }
     
@@ -172,7 +199,7 @@ void GraphVariant::loadAlleles()
   }
 }
 
-GraphVariant::Cat GraphVariant::varCat(Variant& var) const
+GraphVariant::Cat GraphVariant::varCat(const VCFSite& var) const
 {
   int ref_len = var.alleles[0].length();
   bool ins = false;
@@ -225,36 +252,31 @@ const list<Node*>& GraphVariant::getGraphAllele(int i) const
   return _graphAlleles[i];
 }
 
-const Variant& GraphVariant::getVariant() const
+const VCFSite& GraphVariant::getVariant() const
 {
   return _var;
 }
 
-void GraphVariant::getReferencePathTo(const GraphVariant& other,
-                                      list<Node*>& outPath) const
+int64_t GraphVariant::getRank() const
 {
-  outPath.clear();
-
-  // scan to end of reference allele
-  std::list<vg::Mapping>::const_iterator i = _mappingIt;
-  for (; i != _path->end() &&
-          i->position().node_id() != _graphAlleles[0].back()->id(); ++i);
-  assert(i != _path->end());
-  assert(i->position().node_id() == _graphAlleles[0].back()->id());
-
-  // our destination:
-  Node* otherHead = other._graphAlleles[0].front();
+  return _rank;
+}
 
-  // walk one step, then start keeping track of our path
-  // (all nodes between _graphAlleles[0].back() and
-  //  other._graphAlleles[0].front(), exclusive)
-  for (++i; i != _path->end() && i->position().node_id() != otherHead->id(); ++i)
-  {
-    outPath.push_back(_vg->get_node(i->position().node_id()));
-  }
+void GraphVariant::getReferencePathTo(const GraphVariant& other,
+                                      vector<Node*>& outPath) const
+{
+  // all nodes between _graphAlleles[0].back() and
+  // other._graphAlleles[0].front(), exclusive, are just a slice
+  // of the path index
+  size_t first = _rank + _graphAlleles[0].size();
+  size_t last = other._rank;
+  
+  // no way this can be backwards since other is further down
+  assert(first <= last);
+  assert(_path->getNode(first - 1) == _graphAlleles[0].back());
+  assert(_path->getNode(last) == other._graphAlleles[0].front());
 
-  // no way we should get to end since other is between it and us
-  assert(i != _path->end());
+  _path->getNodes(first, last, outPath);
 }
 
 bool GraphVariant::overlaps(const GraphVariant& other) const
@@ -281,9 +303,23 @@ bool GraphVariant::istreq(const string& s1, const string& s2,
   return true;
 }
 
+bool GraphVariant::matchesAt(const string& upper, size_t offset,
+                             const string& sequence)
+{
+  if (offset + sequence.length() > upper.length())
+  {
+    return false;
+  }
+  // node sequences are almost always upper case already.  only if
+  // they differ do we need to check for lower case letters
+  return memcmp(upper.data() + offset, sequence.data(),
+                sequence.length()) == 0 ||
+     istreq(upper, sequence, offset, 0, sequence.length());
+}
+
 ostream& operator<<(ostream& os, const GraphVariant& gv)
 {
-  const Variant v = gv.getVariant();
+  const VCFSite& v = gv.getVariant();
   os << "GV:[" << v.sequenceName << ":" << v.position;
   for (int i = 0; i < v.alleles.size(); ++i)
   {
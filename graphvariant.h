@@ -12,11 +12,13 @@
 #include <limits>
 #include <map>
 #include <stdexcept>
+#include <cstring>
 
 #include <sstream>
 
 #include "vg/src/vg.hpp"
-#include "Variant.h"
+#include "gtreader.h"
+#include "pathindex.h"
 
 /** 
 Maintain a mapping between a vcf variant and the vg graph
@@ -34,16 +36,25 @@ public:
    enum Cat {SNP, DEL, INS, INDEL, REFONLY};
    
    GraphVariant();
-   GraphVariant(vcflib::Variant& var);
    
    ~GraphVariant();
 
-   /** reset path and set offset */
-   void init(int offset);
+   /** set path and offset */
+   void init(const PathIndex* path, int offset);
    
-   /** scan forward along the path until we hit given Variant.
+   /** look up the given variant in the path.  Variants can be 
+    * loaded in any order.
     */
-   void loadVariant(vg::VG* vg, vcflib::Variant& var);
+   void loadVariant(vg::VG* vg, const VCFSite& var);
+
+   /** load a variant whose alleles were already found (see
+    * getAlleleIds()), eg before a checkpoint, without looking them
+    * up again.  throws runtime_error if a node isn't in the graph */
+   void loadVariant(vg::VG* vg, const VCFSite& var,
+                    const std::vector<std::vector<int64_t> >& alleleIds);
+
+   /** node ids of each graph allele */
+   void getAlleleIds(std::vector<std::vector<int64_t> >& outIds) const;
 
    /** how many alleles, reference included, at current variant 
     */
@@ -55,19 +66,22 @@ public:
    /** get vg allele by number */
    const std::list<vg::Node*>& getGraphAllele(int i) const;
 
-   /** access the vcflib variant object */
-   const vcflib::Variant& getVariant() const;
+   /** access the vcf site */
+   const VCFSite& getVariant() const;
+
+   /** rank in path of first node of reference allele */
+   int64_t getRank() const;
 
    /** get path along reference between this variant 
        and another one (further down). */
    void getReferencePathTo(const GraphVariant& other,
-                           std::list<vg::Node*>& outPath) const;
+                           std::vector<vg::Node*>& outPath) const;
 
    /** test if variants overlap.  so we can skip with a warning */
    bool overlaps(const GraphVariant& other) const;
    
    /** what kind of variant.  */
-   Cat varCat(vcflib::Variant& var) const;
+   Cat varCat(const VCFSite& var) const;
 
    /** compare substring [o1, o1+len) of s1 to s2 beginning at o2.
     * case insensitive.  if either of the string not long enough
@@ -75,6 +89,11 @@ public:
    static bool istreq(const std::string& s1, const std::string& s2,
                       int o1 = 0, int o2 = 0, int len = -1);
 
+   /** does sequence match upper, which is already upper case, starting
+    * at offset.  case insensitive */
+   static bool matchesAt(const std::string& upper, size_t offset,
+                         const std::string& sequence);
+
 
 protected:
 
@@ -84,13 +103,14 @@ protected:
 protected:
    
    vg::VG* _vg;
-   std::list<vg::Mapping>* _path;
-   std::list<vg::Mapping>::const_iterator _mappingIt;
-   int _refIdx;
-   vcflib::VariantCallFile* _vcf;
-   vcflib::Variant _var;
+   const PathIndex* _path;
+   /** rank in path of first node of reference allele */
+   int64_t _rank;
+   VCFSite _var;
    int _offset;
    Cat _cat;
+   /** the vcf alleles in upper case */
+   std::vector<std::string> _upperAlleles;
 
    std::vector<std::list<vg::Node*> > _graphAlleles;
    
@@ -0,0 +1,781 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include "graphwindow.h"
+
+using namespace vg;
+using namespace std;
+using namespace google::protobuf;
+using google::protobuf::internal::WireFormatLite;
+
+const size_t MappedInputStream::MaxBlockBytes;
+
+MappedInputStream::MappedInputStream() : _data(NULL), _size(0), _pos(0)
+{
+}
+
+MappedInputStream::~MappedInputStream()
+{
+  close();
+}
+
+void MappedInputStream::open(const string& path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+    throw runtime_error("Could not read " + path);
+  }
+  _size = st.st_size;
+  if (_size > 0)
+  {
+    void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      ::close(fd);
+      _size = 0;
+      throw runtime_error("Could not map " + path);
+    }
+    _data = (const char*)data;
+    // let the kernel read ahead
+    madvise(data, _size, MADV_SEQUENTIAL);
+  }
+  // the mapping stays good without the descriptor
+  ::close(fd);
+}
+
+void MappedInputStream::close()
+{
+  if (_data != NULL)
+  {
+    munmap((void*)_data, _size);
+  }
+  _data = NULL;
+  _size = 0;
+  _pos = 0;
+}
+
+bool MappedInputStream::Next(const void** data, int* size)
+{
+  if (_pos >= _size)
+  {
+    return false;
+  }
+  size_t blockSize = min(_size - _pos, MaxBlockBytes);
+  *data = _data + _pos;
+  *size = (int)blockSize;
+  _pos += blockSize;
+  return true;
+}
+
+void MappedInputStream::BackUp(int count)
+{
+  assert(count >= 0 && (size_t)count <= _pos);
+  _pos -= count;
+}
+
+bool MappedInputStream::Skip(int count)
+{
+  if ((size_t)count > _size - _pos)
+  {
+    _pos = _size;
+    return false;
+  }
+  _pos += count;
+  return true;
+}
+
+int64 MappedInputStream::ByteCount() const
+{
+  return _pos;
+}
+
+GraphChunkReader::GraphChunkReader() : _gzipIn(NULL), _numLeft(0)
+{
+}
+
+GraphChunkReader::~GraphChunkReader()
+{
+  close();
+}
+
+void GraphChunkReader::open(const string& path)
+{
+  close();
+  _path = path;
+  _mappedIn.open(path);
+  _gzipIn = new io::GzipInputStream(&_mappedIn);
+  _numLeft = 0;
+}
+
+bool GraphChunkReader::readChunk(Graph& chunk)
+{
+  if (!readChunkData(_buffer))
+  {
+    return false;
+  }
+  chunk.Clear();
+  if (!_buffer.empty() && !chunk.ParseFromString(_buffer))
+  {
+    throw runtime_error("Error reading chunk from " + _path);
+  }
+  return true;
+}
+
+bool GraphChunkReader::readChunkData(string& data)
+{
+  // each group starts with its number of chunks.  a new coded stream
+  // is made for every read (as in vg::stream) so the byte limits
+  // don't add up over the file
+  while (_numLeft == 0)
+  {
+    io::CodedInputStream codedIn(_gzipIn);
+    if (!codedIn.ReadVarint64(&_numLeft) || _numLeft == 0)
+    {
+      return false;
+    }
+  }
+
+  io::CodedInputStream codedIn(_gzipIn);
+  codedIn.SetTotalBytesLimit(MaxChunkBytes * 2, MaxChunkBytes);
+  uint32 size = 0;
+  if (!codedIn.ReadVarint32(&size) || size > MaxChunkBytes)
+  {
+    throw runtime_error("Error reading chunk size from " + _path);
+  }
+  --_numLeft;
+  data.clear();
+  if (size > 0 && !codedIn.ReadString(&data, size))
+  {
+    throw runtime_error("Error reading chunk from " + _path);
+  }
+  return true;
+}
+
+void GraphChunkReader::close()
+{
+  delete _gzipIn;
+  _gzipIn = NULL;
+  _mappedIn.close();
+}
+
+GraphChunkWriter::GraphChunkWriter() : _out(NULL), _rawOut(NULL),
+                                       _gzipOut(NULL)
+{
+}
+
+GraphChunkWriter::~GraphChunkWriter()
+{
+  delete _gzipOut;
+  delete _rawOut;
+}
+
+void GraphChunkWriter::open(ostream* out)
+{
+  delete _gzipOut;
+  delete _rawOut;
+  _out = out;
+  _rawOut = new io::OstreamOutputStream(_out);
+  _gzipOut = new io::GzipOutputStream(_rawOut);
+}
+
+void GraphChunkWriter::writeChunk(const Graph& chunk)
+{
+  if (!chunk.SerializeToString(&_buffer))
+  {
+    throw runtime_error("Error serializing graph");
+  }
+  writeChunkData(_buffer);
+}
+
+void GraphChunkWriter::writeChunkData(const string& data)
+{
+  assert(_gzipOut != NULL);
+  io::CodedOutputStream codedOut(_gzipOut);
+  codedOut.WriteVarint64(1);
+  codedOut.WriteVarint32(data.size());
+  codedOut.WriteRaw(data.data(), data.size());
+  if (codedOut.HadError())
+  {
+    throw runtime_error("Error writing graph");
+  }
+}
+
+void GraphChunkWriter::close()
+{
+  if (_gzipOut == NULL)
+  {
+    return;
+  }
+  bool closed = _gzipOut->Close();
+  delete _gzipOut;
+  _gzipOut = NULL;
+  delete _rawOut;
+  _rawOut = NULL;
+  if (!closed || !_out->good())
+  {
+    throw runtime_error("Error writing graph");
+  }
+}
+
+GraphWindow::GraphWindow() : _writer(NULL), _maxId(0)
+{
+}
+
+GraphWindow::~GraphWindow()
+{
+}
+
+void GraphWindow::open(const string& path, GraphChunkWriter* writer)
+{
+  init(path, writer);
+
+  // first pass: we need to know the path lengths up front (to know
+  // where the graph ends), and the largest id (so new nodes can't
+  // clash with ones we haven't loaded yet)
+  _reader.open(path);
+  string data;
+  while (_reader.readChunkData(data))
+  {
+    scanChunk(data);
+  }
+  _reader.close();
+
+  // second pass is the real one
+  _reader.open(path);
+}
+
+void GraphWindow::close()
+{
+  while (!_chunks.empty())
+  {
+    flushChunk();
+  }
+
+  copyRest();
+  _reader.close();
+  if (_writer != NULL)
+  {
+    _writer->close();
+  }
+}
+
+VG* GraphWindow::getGraph()
+{
+  return &_vg;
+}
+
+const vector<string>& GraphWindow::getPathNames() const
+{
+  return _pathNames;
+}
+
+bool GraphWindow::hasPath(const string& pathName) const
+{
+  map<string, int64_t>::const_iterator i = _frontiers.find(pathName);
+  return _pathLengths.find(pathName) != _pathLengths.end() &&
+     (i == _frontiers.end() || i->second < numeric_limits<int64_t>::max());
+}
+
+int64_t GraphWindow::getPathLength(const string& pathName) const
+{
+  map<string, int64_t>::const_iterator i = _pathLengths.find(pathName);
+  return i == _pathLengths.end() ? 0 : i->second;
+}
+
+bool GraphWindow::loadChunk()
+{
+  Graph chunk;
+  if (!readChunk(chunk))
+  {
+    return false;
+  }
+  filterEdges(chunk);
+
+  _chunks.push_back(Chunk());
+  Chunk& info = _chunks.back();
+  info.minId = numeric_limits<int64_t>::max();
+  info.maxId = 0;
+  info.nodes.reserve(chunk.node_size());
+  for (int i = 0; i < chunk.node_size(); ++i)
+  {
+    int64_t id = chunk.node(i).id();
+    info.nodes.push_back(id);
+    info.minId = min(info.minId, id);
+    info.maxId = max(info.maxId, id);
+  }
+  for (int i = 0; i < chunk.path_size(); ++i)
+  {
+    const Path& path = chunk.path(i);
+    if (path.mapping_size() > 0)
+    {
+      int64_t& loaded = _pathLoaded[path.name()];
+      loaded += path.mapping_size();
+      PathRange range = {path.name(), loaded - 1,
+                         (size_t)path.mapping_size()};
+      info.paths.push_back(range);
+    }
+  }
+  if (info.paths.empty())
+  {
+    // no reference nodes: stay in memory as long as the chunk before
+    for (auto& range : _lastPaths)
+    {
+      PathRange noMappings = {range.name, range.lastRank, 0};
+      info.paths.push_back(noMappings);
+    }
+  }
+  else
+  {
+    _lastPaths = info.paths;
+  }
+
+  _vg.extend(chunk);
+  return true;
+}
+
+int64_t GraphWindow::newNodeId()
+{
+  assert(!_chunks.empty());
+  _chunks.back().nodes.push_back(++_maxId);
+  return _maxId;
+}
+
+bool GraphWindow::canRelease(const string& pathName, int64_t frontier,
+                             const vector<int64_t>& pinned)
+{
+  _frontiers[pathName] = frontier;
+  return !_chunks.empty() && canFlush(_chunks.front(), pinned);
+}
+
+bool GraphWindow::release(const string& pathName, int64_t frontier,
+                          const vector<int64_t>& pinned)
+{
+  _frontiers[pathName] = frontier;
+  bool flushed = false;
+  while (!_chunks.empty() && canFlush(_chunks.front(), pinned))
+  {
+    flushChunk();
+    flushed = true;
+  }
+  return flushed;
+}
+
+bool GraphWindow::finishPath(const string& pathName)
+{
+  return release(pathName, numeric_limits<int64_t>::max(),
+                 vector<int64_t>());
+}
+
+size_t GraphWindow::getNumChunks() const
+{
+  return _chunks.size();
+}
+
+void GraphWindow::init(const string& path, GraphChunkWriter* writer)
+{
+  _path = path;
+  _writer = writer;
+  _chunks.clear();
+  _lastPaths.clear();
+  _pathNames.clear();
+  _pathLengths.clear();
+  _pathLoaded.clear();
+  _frontiers.clear();
+  _writtenEdges.clear();
+  _maxId = 0;
+}
+
+bool GraphWindow::readChunk(Graph& chunk)
+{
+  return _reader.readChunk(chunk);
+}
+
+void GraphWindow::copyRest()
+{
+  if (_writer == NULL)
+  {
+    return;
+  }
+  // anything we never looked at goes straight through.  it only
+  // needs parsing if it might have edges that were already written
+  string data;
+  Graph chunk;
+  while (_reader.readChunkData(data))
+  {
+    if (_writtenEdges.empty())
+    {
+      _writer->writeChunkData(data);
+    }
+    else
+    {
+      chunk.Clear();
+      if (!data.empty() && !chunk.ParseFromString(data))
+      {
+        throw runtime_error("Error reading chunk from " + _path);
+      }
+      filterEdges(chunk);
+      _writer->writeChunk(chunk);
+    }
+  }
+}
+
+bool GraphWindow::canFlush(const Chunk& chunk,
+                           const vector<int64_t>& pinned) const
+{
+  for (auto& range : chunk.paths)
+  {
+    map<string, int64_t>::const_iterator i = _frontiers.find(range.name);
+    if (i == _frontiers.end() || range.lastRank >= i->second)
+    {
+      return false;
+    }
+  }
+  for (auto id : pinned)
+  {
+    if (id >= chunk.minId && id <= chunk.maxId)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GraphWindow::flushChunk()
+{
+  Chunk& chunk = _chunks.front();
+  Graph out;
+
+  // our chunk's mappings are always at the front of its paths
+  for (auto& range : chunk.paths)
+  {
+    if (range.numMappings > 0)
+    {
+      Path* path = out.add_path();
+      path->set_name(range.name);
+      list<Mapping>::iterator i = _vg.paths.get_path(range.name).begin();
+      for (size_t j = 0; j < range.numMappings; ++j, ++i)
+      {
+        *path->add_mapping() = *i;
+      }
+    }
+  }
+
+  // note we don't use references here because they get altered by
+  // calls to destroy.
+  set<Edge*> edges;
+  for (auto id : chunk.nodes)
+  {
+    Node* node = _vg.get_node(id);
+    *out.add_node() = *node;
+    vector<pair<int64_t, bool> > outEdges = _vg.edges_on_end[id];
+    for (auto p : outEdges)
+    {
+      Edge* edge = _vg.get_edge(NodeSide(id, true),
+                                NodeSide(p.first, p.second));
+      if (edge != NULL)
+      {
+        edges.insert(edge);
+      }
+    }
+    vector<pair<int64_t, bool> > inEdges = _vg.edges_on_start[id];
+    for (auto p : inEdges)
+    {
+      Edge* edge = _vg.get_edge(NodeSide(p.first, !p.second),
+                                NodeSide(id, false));
+      if (edge != NULL)
+      {
+        edges.insert(edge);
+      }
+    }
+  }
+  for (auto edge : edges)
+  {
+    *out.add_edge() = *edge;
+    if (!_vg.has_node(edge->from()) || !_vg.has_node(edge->to()))
+    {
+      // other side hasn't been loaded.  remember so we don't write it
+      // twice
+      _writtenEdges.insert(GraphEdits::edgeSides(*edge));
+    }
+  }
+
+  for (auto id : chunk.nodes)
+  {
+    _vg.paths.remove_node(id);
+    _vg.destroy_node(id);
+  }
+  _chunks.pop_front();
+
+  if (_writer != NULL)
+  {
+    _writer->writeChunk(out);
+  }
+}
+
+void GraphWindow::filterEdges(Graph& graph)
+{
+  if (_writtenEdges.empty())
+  {
+    return;
+  }
+  google::protobuf::RepeatedPtrField<Edge>* edges = graph.mutable_edge();
+  for (int i = edges->size() - 1; i >= 0; --i)
+  {
+    set<pair<NodeSide, NodeSide> >::iterator j =
+       _writtenEdges.find(GraphEdits::edgeSides(edges->Get(i)));
+    if (j != _writtenEdges.end())
+    {
+      _writtenEdges.erase(j);
+      edges->SwapElements(i, edges->size() - 1);
+      edges->RemoveLast();
+    }
+  }
+}
+
+void GraphWindow::scanChunk(const string& data)
+{
+  // the same as parsing the chunk and looking at its nodes and paths,
+  // but without making any objects: sequences are skipped over and
+  // only the fields we want are decoded
+  io::CodedInputStream in((const uint8*)data.data(), data.size());
+  in.SetTotalBytesLimit(GraphChunkReader::MaxChunkBytes,
+                        GraphChunkReader::MaxChunkBytes);
+  map<int64_t, int64_t> nodeLengths;
+  vector<pair<string, vector<ScannedMapping> > > paths;
+  bool good = true;
+  for (uint32 tag = in.ReadTag(); good && tag != 0; tag = in.ReadTag())
+  {
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    bool delimited = WireFormatLite::GetTagWireType(tag) ==
+       WireFormatLite::WIRETYPE_LENGTH_DELIMITED;
+    io::CodedInputStream::Limit limit;
+    if (delimited && field == Graph::kNodeFieldNumber)
+    {
+      int64_t id = 0;
+      int64_t length = 0;
+      good = enterMessage(in, limit) && scanNode(in, id, length);
+      in.PopLimit(limit);
+      _maxId = max(_maxId, id);
+      nodeLengths[id] = length;
+    }
+    else if (delimited && field == Graph::kPathFieldNumber)
+    {
+      paths.push_back(pair<string, vector<ScannedMapping> >());
+      good = enterMessage(in, limit) &&
+         scanPath(in, paths.back().first, paths.back().second);
+      in.PopLimit(limit);
+    }
+    else
+    {
+      good = WireFormatLite::SkipField(&in, tag);
+    }
+  }
+  if (!good || !in.ConsumedEntireMessage())
+  {
+    throw runtime_error("Error reading chunk from " + _path);
+  }
+
+  // mappings without edits cover their whole node, which needn't come
+  // before them in the chunk
+  for (auto& path : paths)
+  {
+    if (_pathLengths.find(path.first) == _pathLengths.end())
+    {
+      _pathNames.push_back(path.first);
+      _pathLengths[path.first] = 0;
+    }
+    int64_t& length = _pathLengths[path.first];
+    for (auto& mapping : path.second)
+    {
+      if (mapping.hasEdits)
+      {
+        length += mapping.length;
+      }
+      else
+      {
+        map<int64_t, int64_t>::iterator l = nodeLengths.find(mapping.nodeId);
+        if (l == nodeLengths.end())
+        {
+          stringstream ss;
+          ss << "Mapping of path " << path.first << " to node "
+             << mapping.nodeId << " is not in the same"
+             << " chunk as the node in " << _path;
+          throw runtime_error(ss.str());
+        }
+        length += l->second;
+      }
+    }
+  }
+}
+
+bool GraphWindow::scanNode(io::CodedInputStream& in, int64_t& id,
+                           int64_t& length)
+{
+  for (uint32 tag = in.ReadTag(); tag != 0; tag = in.ReadTag())
+  {
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    WireFormatLite::WireType type = WireFormatLite::GetTagWireType(tag);
+    uint64 value;
+    uint32 size;
+    if (field == Node::kIdFieldNumber &&
+        type == WireFormatLite::WIRETYPE_VARINT)
+    {
+      if (!in.ReadVarint64(&value))
+      {
+        return false;
+      }
+      id = (int64_t)value;
+    }
+    else if (field == Node::kSequenceFieldNumber &&
+             type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+    {
+      // the length is all we want
+      if (!in.ReadVarint32(&size) || !in.Skip(size))
+      {
+        return false;
+      }
+      length = size;
+    }
+    else if (!WireFormatLite::SkipField(&in, tag))
+    {
+      return false;
+    }
+  }
+  return in.ConsumedEntireMessage();
+}
+
+bool GraphWindow::scanPath(io::CodedInputStream& in, string& name,
+                           vector<ScannedMapping>& mappings)
+{
+  for (uint32 tag = in.ReadTag(); tag != 0; tag = in.ReadTag())
+  {
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    WireFormatLite::WireType type = WireFormatLite::GetTagWireType(tag);
+    uint32 size;
+    io::CodedInputStream::Limit limit;
+    if (field == Path::kNameFieldNumber &&
+        type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+    {
+      if (!in.ReadVarint32(&size) || !in.ReadString(&name, size))
+      {
+        return false;
+      }
+    }
+    else if (field == Path::kMappingFieldNumber &&
+             type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+    {
+      ScannedMapping mapping = {0, false, 0};
+      mappings.push_back(mapping);
+      bool good = enterMessage(in, limit) &&
+         scanMapping(in, mappings.back());
+      in.PopLimit(limit);
+      if (!good)
+      {
+        return false;
+      }
+    }
+    else if (!WireFormatLite::SkipField(&in, tag))
+    {
+      return false;
+    }
+  }
+  return in.ConsumedEntireMessage();
+}
+
+bool GraphWindow::scanMapping(io::CodedInputStream& in,
+                              ScannedMapping& mapping)
+{
+  for (uint32 tag = in.ReadTag(); tag != 0; tag = in.ReadTag())
+  {
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    bool delimited = WireFormatLite::GetTagWireType(tag) ==
+       WireFormatLite::WIRETYPE_LENGTH_DELIMITED;
+    io::CodedInputStream::Limit limit;
+    bool good = true;
+    if (delimited && field == Mapping::kPositionFieldNumber)
+    {
+      // Position: just want the node_id
+      good = enterMessage(in, limit);
+      for (uint32 t = in.ReadTag(); good && t != 0; t = in.ReadTag())
+      {
+        uint64 value;
+        if (WireFormatLite::GetTagFieldNumber(t) ==
+            Position::kNodeIdFieldNumber &&
+            WireFormatLite::GetTagWireType(t) ==
+            WireFormatLite::WIRETYPE_VARINT)
+        {
+          good = in.ReadVarint64(&value);
+          mapping.nodeId = (int64_t)value;
+        }
+        else
+        {
+          good = WireFormatLite::SkipField(&in, t);
+        }
+      }
+      good = good && in.ConsumedEntireMessage();
+      in.PopLimit(limit);
+    }
+    else if (delimited && field == Mapping::kEditFieldNumber)
+    {
+      // Edit: just want the from_length
+      mapping.hasEdits = true;
+      good = enterMessage(in, limit);
+      for (uint32 t = in.ReadTag(); good && t != 0; t = in.ReadTag())
+      {
+        uint64 value;
+        if (WireFormatLite::GetTagFieldNumber(t) ==
+            Edit::kFromLengthFieldNumber &&
+            WireFormatLite::GetTagWireType(t) ==
+            WireFormatLite::WIRETYPE_VARINT)
+        {
+          good = in.ReadVarint64(&value);
+          mapping.length += (int32_t)value;
+        }
+        else
+        {
+          good = WireFormatLite::SkipField(&in, t);
+        }
+      }
+      good = good && in.ConsumedEntireMessage();
+      in.PopLimit(limit);
+    }
+    else
+    {
+      good = WireFormatLite::SkipField(&in, tag);
+    }
+    if (!good)
+    {
+      return false;
+    }
+  }
+  return in.ConsumedEntireMessage();
+}
+
+bool GraphWindow::enterMessage(io::CodedInputStream& in,
+                               io::CodedInputStream::Limit& limit)
+{
+  uint32 size;
+  if (!in.ReadVarint32(&size))
+  {
+    // nothing to pop
+    limit = in.PushLimit(0);
+    return false;
+  }
+  limit = in.PushLimit(size);
+  return true;
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _GRAPHWINDOW_H
+#define _GRAPHWINDOW_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <sstream>
+#include <cstdint>
+#include <limits>
+
+#include "vg/src/vg.hpp"
+#include "vg/src/stream.hpp"
+#include "graphedits.h"
+
+/**
+A whole file mapped read-only into memory, as a protobuf input stream.
+The decompressor reads straight out of the page cache, so the file is
+never copied into a stream buffer.
+*/
+class MappedInputStream : public google::protobuf::io::ZeroCopyInputStream
+{
+public:
+   MappedInputStream();
+   virtual ~MappedInputStream();
+
+   /** map file.  throws runtime_error on failure */
+   void open(const std::string& path);
+
+   void close();
+
+   virtual bool Next(const void** data, int* size);
+   virtual void BackUp(int count);
+   virtual bool Skip(int count);
+   virtual google::protobuf::int64 ByteCount() const;
+
+protected:
+
+   /** Next() hands out an int's worth of bytes at most */
+   static const size_t MaxBlockBytes = 1 << 30;
+
+   const char* _data;
+   size_t _size;
+   size_t _pos;
+};
+
+/**
+Pull Graph chunks one at a time out of a vg file.  Same format as
+vg::stream::for_each() (gzipped groups of length-prefixed messages),
+but we decide when to read the next one, and whether to parse it.
+*/
+class GraphChunkReader
+{
+public:
+
+   static const int MaxChunkBytes = 1000000000;
+
+   GraphChunkReader();
+   ~GraphChunkReader();
+
+   /** open vg file.  throws runtime_error on failure */
+   void open(const std::string& path);
+
+   /** read the next chunk.  returns false at end of file */
+   bool readChunk(vg::Graph& chunk);
+
+   /** read the next chunk's serialized bytes without parsing them.
+    * returns false at end of file */
+   bool readChunkData(std::string& data);
+
+   void close();
+
+protected:
+
+   std::string _path;
+   MappedInputStream _mappedIn;
+   google::protobuf::io::GzipInputStream* _gzipIn;
+   /** chunks left in current group */
+   google::protobuf::uint64 _numLeft;
+   std::string _buffer;
+};
+
+/**
+Write Graph chunks to a stream that vg::stream::for_each() can read,
+one chunk per group, all in a single gzip stream.  Subclasses write
+other formats (see GFAWriter).
+*/
+class GraphChunkWriter
+{
+public:
+   GraphChunkWriter();
+   virtual ~GraphChunkWriter();
+
+   virtual void open(std::ostream* out);
+
+   /** throws runtime_error if it can't be written */
+   virtual void writeChunk(const vg::Graph& chunk);
+
+   /** write a chunk that's already serialized (as from
+    * GraphChunkReader::readChunkData()) */
+   virtual void writeChunkData(const std::string& data);
+
+   /** finish the output.  throws runtime_error if anything couldn't
+    * be written */
+   virtual void close();
+
+protected:
+
+   std::ostream* _out;
+   google::protobuf::io::OstreamOutputStream* _rawOut;
+   google::protobuf::io::GzipOutputStream* _gzipOut;
+   std::string _buffer;
+};
+
+/**
+Keep only a sliding window of a vg file's chunks in memory.  Chunks
+are loaded into one working graph as the variants move forward along
+a path, and written back out (with any new nodes and edges) as soon
+as the variants have moved past them.  So memory depends on the
+window (the distance between the variants and the chunk size) rather
+than on the size of the graph.
+
+Chunks are written out in the order they were read.  A chunk goes
+once every path it has nodes on has moved past it, so paths whose
+variants are never processed stay in memory until close(): the vcf
+should have records on the graph's paths in the same order as the
+vg file.  Relies on the vg construct node order (alleles of a
+variant in the chunk of the reference node before or after it).
+*/
+class GraphWindow
+{
+public:
+   GraphWindow();
+   virtual ~GraphWindow();
+
+   /** read the whole vg file once to get its paths and largest node
+    * id, then open it again for streaming.  chunks that are done with
+    * get written to writer, which must be open (or dropped if it's
+    * NULL, when only the edits are wanted).  The first read only scans the chunks' bytes
+    * for the few fields it needs: nothing is parsed into a Graph */
+   virtual void open(const std::string& path, GraphChunkWriter* writer);
+
+   /** write out all chunks still in memory, then copy over the rest
+    * of the input (see copyRest()), and close the writer */
+   void close();
+
+   /** the working graph: only the loaded chunks */
+   vg::VG* getGraph();
+
+   /** names of paths, in the order they appear in the file */
+   const std::vector<std::string>& getPathNames() const;
+
+   /** is path in the file (and not already finished and written) */
+   bool hasPath(const std::string& pathName) const;
+
+   /** length of whole path in bases (not just what's loaded) */
+   int64_t getPathLength(const std::string& pathName) const;
+
+   /** read the next chunk into the working graph.  false if there
+    * are none left */
+   bool loadChunk();
+
+   /** id for a new node.  nodes made with it are written out with
+    * the most recently loaded chunk */
+   int64_t newNodeId();
+
+   /** would release() write anything */
+   bool canRelease(const std::string& pathName, int64_t frontier,
+                   const std::vector<int64_t>& pinned);
+
+   /** nodes on path with rank < frontier won't be looked at again.
+    * write out (and remove from graph) chunks, oldest first, until
+    * one is found that is still needed or that has a pinned node.
+    * returns true if anything was written */
+   bool release(const std::string& pathName, int64_t frontier,
+                const std::vector<int64_t>& pinned);
+
+   /** done with the whole path */
+   bool finishPath(const std::string& pathName);
+
+   /** number of chunks currently loaded */
+   size_t getNumChunks() const;
+
+protected:
+
+   /** last rank, and number of mappings, a chunk has on a path */
+   struct PathRange
+   {
+      std::string name;
+      int64_t lastRank;
+      size_t numMappings;
+   };
+
+   struct Chunk
+   {
+      int64_t minId;
+      int64_t maxId;
+      std::vector<int64_t> nodes;
+      std::vector<PathRange> paths;
+   };
+
+   /** what the first pass reads of a Mapping */
+   struct ScannedMapping
+   {
+      int64_t nodeId;
+      bool hasEdits;
+      /** total from_length of the edits */
+      int64_t length;
+   };
+
+   /** forget everything and start over with a new input */
+   void init(const std::string& path, GraphChunkWriter* writer);
+
+   /** next chunk of the input.  false if there are none left */
+   virtual bool readChunk(vg::Graph& chunk);
+
+   /** write every chunk that hasn't been read.  here they're copied
+    * as is, without parsing them, if we can */
+   virtual void copyRest();
+
+   /** can the oldest chunk be written */
+   bool canFlush(const Chunk& chunk,
+                 const std::vector<int64_t>& pinned) const;
+
+   /** write oldest chunk and remove it from the graph */
+   void flushChunk();
+
+   /** remove any edges from graph that have already been written */
+   void filterEdges(vg::Graph& graph);
+
+   /** add the nodes and paths of a serialized chunk to _maxId,
+    * _pathNames and _pathLengths */
+   void scanChunk(const std::string& data);
+
+   /** read a Node's id and sequence length from its serialized
+    * bytes.  false if they're bad */
+   static bool scanNode(google::protobuf::io::CodedInputStream& in,
+                        int64_t& id, int64_t& length);
+
+   /** read a Path's name and mappings from its serialized bytes.
+    * false if they're bad */
+   static bool scanPath(google::protobuf::io::CodedInputStream& in,
+                        std::string& name,
+                        std::vector<ScannedMapping>& mappings);
+
+   /** read a Mapping's node and edit lengths */
+   static bool scanMapping(google::protobuf::io::CodedInputStream& in,
+                           ScannedMapping& mapping);
+
+   /** limit in to the length-delimited message that's next */
+   static bool enterMessage(google::protobuf::io::CodedInputStream& in,
+                     google::protobuf::io::CodedInputStream::Limit& limit);
+
+protected:
+
+   std::string _path;
+   GraphChunkReader _reader;
+   GraphChunkWriter* _writer;
+   vg::VG _vg;
+   std::deque<Chunk> _chunks;
+   /** path ranges of last chunk with any mappings, in case next one
+    * doesn't have any */
+   std::vector<PathRange> _lastPaths;
+
+   std::vector<std::string> _pathNames;
+   std::map<std::string, int64_t> _pathLengths;
+   /** number of mappings of each path loaded so far */
+   std::map<std::string, int64_t> _pathLoaded;
+   std::map<std::string, int64_t> _frontiers;
+   int64_t _maxId;
+
+   /** edges written out before their other side was loaded.  if they
+    * show up again in a later chunk they're dropped */
+   std::set<std::pair<vg::NodeSide, vg::NodeSide> > _writtenEdges;
+};
+
+#endif
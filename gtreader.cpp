@@ -0,0 +1,845 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include "gtreader.h"
+
+using namespace std;
+
+static const size_t TextBufferSize = 1 << 20;
+
+GTReader::GTReader()
+{
+}
+
+GTReader::~GTReader()
+{
+}
+
+const vector<string>& GTReader::getSampleNames() const
+{
+  return _sampleNames;
+}
+
+bool GTReader::setRegion(const string& sequenceName, long start, long end)
+{
+  return false;
+}
+
+int64_t GTReader::tell()
+{
+  return -1;
+}
+
+void GTReader::seek(int64_t offset)
+{
+  throw runtime_error("Can't seek in variant file");
+}
+
+void GTReader::setSamples(const vector<string>& samples)
+{
+  set<string> wanted(samples.begin(), samples.end());
+  vector<string> headerNames;
+  headerNames.swap(_sampleNames);
+  _columnSample.assign(headerNames.size(), -1);
+  for (size_t c = 0; c < headerNames.size(); ++c)
+  {
+    if (wanted.erase(headerNames[c]) > 0)
+    {
+      _columnSample[c] = _sampleNames.size();
+      _sampleNames.push_back(headerNames[c]);
+    }
+  }
+  if (_sampleNames.empty())
+  {
+    throw runtime_error("None of the given samples are in the VCF");
+  }
+  if (!wanted.empty())
+  {
+    cerr << "Warning: " << wanted.size() << " of the given samples (eg "
+         << *wanted.begin() << ") are not in the VCF" << endl;
+  }
+  // no need to look at anything past the last column we want
+  while (_columnSample.back() < 0)
+  {
+    _columnSample.pop_back();
+  }
+}
+
+TextGTReader::TextGTReader() : _file(NULL), _eof(true), _bufPos(0),
+                               _bufEnd(0), _lineStart(NULL), _lineEnd(NULL),
+                               _lineNumber(0), _gtField(-1), _ploidy(2),
+                               _htsFile(NULL), _tbx(NULL), _itr(NULL),
+                               _inRegion(false)
+{
+  _kline.l = 0;
+  _kline.m = 0;
+  _kline.s = NULL;
+}
+
+TextGTReader::~TextGTReader()
+{
+  if (_file != NULL)
+  {
+    gzclose(_file);
+  }
+  if (_itr != NULL)
+  {
+    tbx_itr_destroy(_itr);
+  }
+  if (_tbx != NULL)
+  {
+    tbx_destroy(_tbx);
+  }
+  if (_htsFile != NULL)
+  {
+    hts_close(_htsFile);
+  }
+  free(_kline.s);
+}
+
+void TextGTReader::open(const string& path)
+{
+  _path = path;
+  // gzopen reads uncompressed files transparently
+  _file = gzopen(path.c_str(), "rb");
+  if (_file == NULL)
+  {
+    throw runtime_error("Could not read " + path);
+  }
+  _buffer.resize(TextBufferSize);
+  _bufPos = 0;
+  _bufEnd = 0;
+  _eof = false;
+  _lineNumber = 0;
+  readHeader();
+}
+
+bool TextGTReader::getNextRecord(GTRecord& rec)
+{
+  while (readLine())
+  {
+    if (_lineEnd > _lineStart && *_lineStart != '#')
+    {
+      parseRecord(rec);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TextGTReader::setRegion(const string& sequenceName, long start,
+                             long end)
+{
+  if (_tbx == NULL)
+  {
+    if (!hasIndex(_path) || (_tbx = tbx_index_load(_path.c_str())) == NULL)
+    {
+      return false;
+    }
+    _htsFile = hts_open(_path.c_str(), "r");
+    if (_htsFile == NULL)
+    {
+      throw runtime_error("Could not read " + _path);
+    }
+  }
+  if (_itr != NULL)
+  {
+    tbx_itr_destroy(_itr);
+  }
+  stringstream ss;
+  ss << sequenceName << ":" << start << "-" << end;
+  // NULL iterator means sequence isn't in the index: no records
+  _itr = tbx_itr_querys(_tbx, ss.str().c_str());
+  _inRegion = true;
+  return true;
+}
+
+int64_t TextGTReader::tell()
+{
+  if (_inRegion)
+  {
+    return -1;
+  }
+  // the rest of the buffer hasn't been read yet
+  return gztell(_file) - (int64_t)(_bufEnd - _bufPos);
+}
+
+void TextGTReader::seek(int64_t offset)
+{
+  // on a gzipped file this decompresses its way there, but doesn't
+  // parse anything
+  if (_inRegion || gzseek(_file, offset, SEEK_SET) < 0)
+  {
+    throw runtime_error("Could not seek in " + _path);
+  }
+  _bufPos = 0;
+  _bufEnd = 0;
+  _eof = false;
+}
+
+bool TextGTReader::readLine()
+{
+  if (_inRegion)
+  {
+    if (_itr == NULL || tbx_itr_next(_htsFile, _tbx, _itr, &_kline) < 0)
+    {
+      return false;
+    }
+    _lineStart = _kline.s;
+    _lineEnd = _kline.s + _kline.l;
+    ++_lineNumber;
+    return true;
+  }
+
+  _line.clear();
+  while (true)
+  {
+    if (_bufPos == _bufEnd)
+    {
+      if (_eof)
+      {
+        // last line had no newline
+        _lineStart = _line.data();
+        _lineEnd = _lineStart + _line.length();
+        return !_line.empty();
+      }
+      int n = gzread(_file, &_buffer[0], _buffer.size());
+      if (n < 0)
+      {
+        throw runtime_error("Error reading " + _path);
+      }
+      _eof = n == 0;
+      _bufPos = 0;
+      _bufEnd = n;
+      continue;
+    }
+    char* start = &_buffer[_bufPos];
+    char* newline = (char*)memchr(start, '\n', _bufEnd - _bufPos);
+    if (newline == NULL)
+    {
+      _line.append(start, _bufEnd - _bufPos);
+      _bufPos = _bufEnd;
+      continue;
+    }
+    _bufPos += newline - start + 1;
+    if (_line.empty())
+    {
+      _lineStart = start;
+      _lineEnd = newline;
+    }
+    else
+    {
+      _line.append(start, newline - start);
+      _lineStart = _line.data();
+      _lineEnd = _lineStart + _line.length();
+    }
+    if (_lineEnd > _lineStart && *(_lineEnd - 1) == '\r')
+    {
+      --_lineEnd;
+    }
+    ++_lineNumber;
+    return true;
+  }
+}
+
+void TextGTReader::readHeader()
+{
+  _sampleNames.clear();
+  while (readLine())
+  {
+    if (_lineEnd - _lineStart >= 6 && strncmp(_lineStart, "#CHROM", 6) == 0)
+    {
+      // sample names are the 10th column onward
+      int column = 0;
+      for (const char* p = _lineStart; p < _lineEnd; ++column)
+      {
+        const char* end = (const char*)memchr(p, '\t', _lineEnd - p);
+        if (end == NULL)
+        {
+          end = _lineEnd;
+        }
+        if (column >= 9)
+        {
+          _sampleNames.push_back(string(p, end));
+        }
+        p = end + 1;
+      }
+      return;
+    }
+    if (_lineEnd == _lineStart || *_lineStart != '#')
+    {
+      break;
+    }
+  }
+  throw runtime_error("No #CHROM header line found in " + _path);
+}
+
+void TextGTReader::parseRecord(GTRecord& rec)
+{
+  const char* p = _lineStart;
+  const char* end = _lineEnd;
+  const char* fieldEnd = NULL;
+
+  // get next tab-delimited field, leaving p at its start and
+  // fieldEnd at its end
+  auto nextField = [&]() -> bool {
+    if (fieldEnd != NULL)
+    {
+      if (fieldEnd >= end)
+      {
+        return false;
+      }
+      p = fieldEnd + 1;
+    }
+    fieldEnd = (const char*)memchr(p, '\t', end - p);
+    if (fieldEnd == NULL)
+    {
+      fieldEnd = end;
+    }
+    return true;
+  };
+
+  for (int i = 0; i < 5; ++i)
+  {
+    if (!nextField())
+    {
+      stringstream ss;
+      ss << "Truncated record on line " << _lineNumber << " of " << _path;
+      throw runtime_error(ss.str());
+    }
+    switch (i)
+    {
+    case 0:
+      rec.sequenceName.assign(p, fieldEnd);
+      break;
+    case 1:
+      rec.position = strtol(p, NULL, 10);
+      break;
+    case 3:
+      rec.alleles.resize(1);
+      rec.alleles[0].assign(p, fieldEnd);
+      break;
+    case 4:
+      // comma-separated alts.  a lone . means there aren't any
+      if (!(fieldEnd - p == 1 && *p == '.'))
+      {
+        for (const char* a = p; a <= fieldEnd;)
+        {
+          const char* aEnd = (const char*)memchr(a, ',', fieldEnd - a);
+          if (aEnd == NULL)
+          {
+            aEnd = fieldEnd;
+          }
+          rec.alleles.push_back(string(a, aEnd));
+          a = aEnd + 1;
+        }
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  // skip QUAL FILTER INFO and find GT in FORMAT
+  bool haveFormat = nextField() && nextField() && nextField() && nextField();
+  if (haveFormat)
+  {
+    updateFormat(p, fieldEnd);
+  }
+
+  int numSamples = _sampleNames.size();
+  rec.sampleNames = &_sampleNames;
+  rec.samplePloidy.assign(numSamples, 0);
+  rec.ploidy = _ploidy;
+  rec.haplotypes.assign((size_t)numSamples * _ploidy, GTRecord::Unused);
+  if (!haveFormat || _gtField < 0)
+  {
+    // no GT for anybody
+    return;
+  }
+
+  int numColumns = _columnSample.empty() ? numSamples : _columnSample.size();
+  for (int col = 0; col < numColumns && nextField(); ++col)
+  {
+    int s = _columnSample.empty() ? col : _columnSample[col];
+    if (s < 0)
+    {
+      // not one of our samples
+      continue;
+    }
+
+    // skip to the GT subfield
+    const char* gt = p;
+    for (int f = 0; f < _gtField && gt != NULL; ++f)
+    {
+      gt = (const char*)memchr(gt, ':', fieldEnd - gt);
+      if (gt != NULL)
+      {
+        ++gt;
+      }
+    }
+    if (gt == NULL)
+    {
+      continue;
+    }
+    const char* gtEnd = (const char*)memchr(gt, ':', fieldEnd - gt);
+    if (gtEnd == NULL)
+    {
+      gtEnd = fieldEnd;
+    }
+
+    // GT looks like 0|1 1|0 2|1 etc.  so each | delimited
+    // field is one chromosome.  . is missing.  anything else that
+    // doesn't start with a number is read as 0.
+    int chrom = 0;
+    for (const char* h = gt; h <= gtEnd; ++chrom)
+    {
+      const char* hEnd = (const char*)memchr(h, '|', gtEnd - h);
+      if (hEnd == NULL)
+      {
+        hEnd = gtEnd;
+      }
+      if (chrom >= rec.ploidy)
+      {
+        setPloidy(rec, chrom + 1);
+        _ploidy = rec.ploidy;
+      }
+      int allele = 0;
+      if (hEnd - h == 1 && *h == '.')
+      {
+        allele = GTRecord::Missing;
+      }
+      else
+      {
+        for (const char* c = h; c < hEnd && *c >= '0' && *c <= '9'; ++c)
+        {
+          allele = allele * 10 + (*c - '0');
+        }
+      }
+      rec.haplotypes[(size_t)s * rec.ploidy + chrom] = allele;
+      h = hEnd + 1;
+    }
+    rec.samplePloidy[s] = chrom;
+  }
+}
+
+void TextGTReader::updateFormat(const char* start, const char* end)
+{
+  // format is almost always the same from one line to the next
+  if (_format.length() == (size_t)(end - start) &&
+      memcmp(_format.data(), start, end - start) == 0)
+  {
+    return;
+  }
+  _format.assign(start, end);
+  _gtField = -1;
+  int field = 0;
+  for (const char* p = start; p <= end; ++field)
+  {
+    const char* fEnd = (const char*)memchr(p, ':', end - p);
+    if (fEnd == NULL)
+    {
+      fEnd = end;
+    }
+    if (fEnd - p == 2 && p[0] == 'G' && p[1] == 'T')
+    {
+      _gtField = field;
+      break;
+    }
+    p = fEnd + 1;
+  }
+}
+
+void TextGTReader::setPloidy(GTRecord& rec, int ploidy)
+{
+  int numSamples = rec.samplePloidy.size();
+  vector<int> haplotypes((size_t)numSamples * ploidy, GTRecord::Unused);
+  for (int s = 0; s < numSamples; ++s)
+  {
+    for (int h = 0; h < rec.ploidy; ++h)
+    {
+      haplotypes[(size_t)s * ploidy + h] =
+         rec.haplotypes[(size_t)s * rec.ploidy + h];
+    }
+  }
+  rec.haplotypes.swap(haplotypes);
+  rec.ploidy = ploidy;
+}
+
+BCFGTReader::BCFGTReader() : _file(NULL), _header(NULL), _rec(NULL),
+                             _idx(NULL), _itr(NULL), _inRegion(false),
+                             _gts(NULL), _gtsSize(0)
+{
+}
+
+BCFGTReader::~BCFGTReader()
+{
+  free(_gts);
+  if (_itr != NULL)
+  {
+    bcf_itr_destroy(_itr);
+  }
+  if (_idx != NULL)
+  {
+    hts_idx_destroy(_idx);
+  }
+  if (_rec != NULL)
+  {
+    bcf_destroy(_rec);
+  }
+  if (_header != NULL)
+  {
+    bcf_hdr_destroy(_header);
+  }
+  if (_file != NULL)
+  {
+    hts_close(_file);
+  }
+}
+
+void BCFGTReader::open(const string& path)
+{
+  _path = path;
+  _file = hts_open(path.c_str(), "rb");
+  if (_file == NULL || (_header = bcf_hdr_read(_file)) == NULL)
+  {
+    throw runtime_error("Could not read " + path);
+  }
+  _rec = bcf_init();
+  _sampleNames.clear();
+  for (int i = 0; i < bcf_hdr_nsamples(_header); ++i)
+  {
+    _sampleNames.push_back(_header->samples[i]);
+  }
+}
+
+bool BCFGTReader::setRegion(const string& sequenceName, long start, long end)
+{
+  if (_idx == NULL)
+  {
+    if (!hasIndex(_path) || (_idx = bcf_index_load(_path.c_str())) == NULL)
+    {
+      return false;
+    }
+  }
+  if (_itr != NULL)
+  {
+    bcf_itr_destroy(_itr);
+  }
+  stringstream ss;
+  ss << sequenceName << ":" << start << "-" << end;
+  // NULL iterator means sequence isn't in the index: no records
+  _itr = bcf_itr_querys(_idx, _header, ss.str().c_str());
+  _inRegion = true;
+  return true;
+}
+
+int64_t BCFGTReader::tell()
+{
+  BGZF* bgzf = hts_get_bgzfp(_file);
+  return _inRegion || bgzf == NULL ? -1 : bgzf_tell(bgzf);
+}
+
+void BCFGTReader::seek(int64_t offset)
+{
+  BGZF* bgzf = hts_get_bgzfp(_file);
+  if (_inRegion || bgzf == NULL || bgzf_seek(bgzf, offset, SEEK_SET) < 0)
+  {
+    throw runtime_error("Could not seek in " + _path);
+  }
+}
+
+void BCFGTReader::setSamples(const vector<string>& samples)
+{
+  GTReader::setSamples(samples);
+  // htslib drops the other samples as it reads each record, so the
+  // record looks like it only ever had ours
+  string list;
+  for (auto& name : _sampleNames)
+  {
+    list += (list.empty() ? "" : ",") + name;
+  }
+  if (bcf_hdr_set_samples(_header, list.c_str(), 0) != 0 ||
+      bcf_hdr_nsamples(_header) != (int)_sampleNames.size())
+  {
+    throw runtime_error("Error selecting samples from " + _path);
+  }
+}
+
+bool BCFGTReader::getNextRecord(GTRecord& rec)
+{
+  int ret;
+  if (_inRegion)
+  {
+    ret = _itr == NULL ? -1 : bcf_itr_next(_file, _itr, _rec);
+  }
+  else
+  {
+    ret = bcf_read(_file, _header, _rec);
+  }
+  if (ret < -1)
+  {
+    throw runtime_error("Error reading " + _path);
+  }
+  if (ret < 0)
+  {
+    return false;
+  }
+
+  bcf_unpack(_rec, BCF_UN_STR);
+  rec.sequenceName = bcf_seqname(_header, _rec);
+  rec.position = _rec->pos + 1;
+  rec.alleles.resize(_rec->n_allele);
+  for (int i = 0; i < _rec->n_allele; ++i)
+  {
+    rec.alleles[i] = _rec->d.allele[i];
+  }
+
+  // GT comes back as numSamples * maxPloidy values, padded with
+  // vector_end for samples of lower ploidy
+  int numSamples = _sampleNames.size();
+  int numGts = bcf_get_genotypes(_header, _rec, &_gts, &_gtsSize);
+  int maxPloidy = numGts > 0 && numSamples > 0 ? numGts / numSamples : 0;
+  rec.sampleNames = &_sampleNames;
+  rec.samplePloidy.assign(numSamples, 0);
+  rec.ploidy = max(1, maxPloidy);
+  rec.haplotypes.assign((size_t)numSamples * rec.ploidy, GTRecord::Unused);
+  for (int s = 0; s < numSamples && maxPloidy > 0; ++s)
+  {
+    int32_t* gt = _gts + (size_t)s * maxPloidy;
+    int* haplotypes = &rec.haplotypes[(size_t)s * rec.ploidy];
+    int chrom = 0;
+    for (int i = 0; i < maxPloidy && gt[i] != bcf_int32_vector_end; ++i)
+    {
+      if (i > 0 && !bcf_gt_is_phased(gt[i]))
+      {
+        // same as the text reader: alleles joined by / are one
+        // chromosome whose allele is the first one, or 0 when that
+        // isn't a lone .
+        if (haplotypes[chrom - 1] == GTRecord::Missing)
+        {
+          haplotypes[chrom - 1] = 0;
+        }
+        continue;
+      }
+      haplotypes[chrom++] = bcf_gt_is_missing(gt[i]) ? (int)GTRecord::Missing :
+         bcf_gt_allele(gt[i]);
+    }
+    rec.samplePloidy[s] = chrom;
+  }
+  return true;
+}
+
+MergedGTReader::MergedGTReader() : _indexed(false)
+{
+}
+
+MergedGTReader::~MergedGTReader()
+{
+  for (auto shard : _shards)
+  {
+    delete shard;
+  }
+}
+
+void MergedGTReader::open(const string& path)
+{
+  _paths.clear();
+  stringstream ss(path);
+  string shardPath;
+  while (getline(ss, shardPath, ','))
+  {
+    if (!shardPath.empty())
+    {
+      _paths.push_back(shardPath);
+    }
+  }
+  if (_paths.empty())
+  {
+    throw runtime_error("No vcf in " + path);
+  }
+  _indexed = true;
+  for (auto& p : _paths)
+  {
+    GTReader* shard = newGTReader(p);
+    _shards.push_back(shard);
+    shard->open(p);
+    _indexed = _indexed && hasIndex(p);
+  }
+  _records.resize(_shards.size());
+  mergeSampleNames();
+}
+
+bool MergedGTReader::getNextRecord(GTRecord& rec)
+{
+  // only now, as setSamples() may have dropped one of the copies
+  if (!_duplicateError.empty())
+  {
+    throw runtime_error(_duplicateError);
+  }
+  // the shards have the same sites, so they run out together
+  size_t numDone = 0;
+  for (size_t i = 0; i < _shards.size(); ++i)
+  {
+    if (!_shards[i]->getNextRecord(_records[i]))
+    {
+      ++numDone;
+    }
+  }
+  if (numDone == _shards.size())
+  {
+    return false;
+  }
+  if (numDone > 0)
+  {
+    throw runtime_error("Merged vcfs " + _paths[0] + " etc. don't have the "
+                        "same number of records");
+  }
+
+  const GTRecord& first = _records[0];
+  int ploidy = 1;
+  for (size_t i = 0; i < _records.size(); ++i)
+  {
+    const GTRecord& shardRec = _records[i];
+    if (shardRec.position != first.position ||
+        shardRec.sequenceName != first.sequenceName ||
+        shardRec.alleles != first.alleles)
+    {
+      stringstream ss;
+      ss << "Record " << shardRec << " of " << _paths[i] << " doesn't match "
+         << first << " of " << _paths[0] << ": merged vcfs must have the "
+         << "same sites in the same order";
+      throw runtime_error(ss.str());
+    }
+    ploidy = max(ploidy, shardRec.ploidy);
+  }
+
+  rec.sequenceName = first.sequenceName;
+  rec.position = first.position;
+  rec.alleles = first.alleles;
+  rec.sampleNames = &_sampleNames;
+  rec.ploidy = ploidy;
+  rec.samplePloidy.resize(_sampleNames.size());
+  rec.haplotypes.assign(_sampleNames.size() * ploidy, GTRecord::Unused);
+  size_t offset = 0;
+  for (auto& shardRec : _records)
+  {
+    size_t numSamples = shardRec.samplePloidy.size();
+    for (size_t s = 0; s < numSamples; ++s)
+    {
+      rec.samplePloidy[offset + s] = shardRec.samplePloidy[s];
+      copy(shardRec.haplotypes.begin() + s * shardRec.ploidy,
+           shardRec.haplotypes.begin() + (s + 1) * shardRec.ploidy,
+           rec.haplotypes.begin() + (offset + s) * ploidy);
+    }
+    offset += numSamples;
+  }
+  return true;
+}
+
+bool MergedGTReader::setRegion(const string& sequenceName, long start,
+                               long end)
+{
+  // all or nothing, or the shards would fall out of step
+  if (!_indexed)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < _shards.size(); ++i)
+  {
+    if (!_shards[i]->setRegion(sequenceName, start, end))
+    {
+      throw runtime_error("Could not load index of " + _paths[i]);
+    }
+  }
+  return true;
+}
+
+void MergedGTReader::setSamples(const vector<string>& samples)
+{
+  set<string> wanted(samples.begin(), samples.end());
+  size_t numKept = 0;
+  for (size_t i = 0; i < _shards.size(); ++i)
+  {
+    vector<string> shardSamples;
+    for (auto& name : _shards[i]->getSampleNames())
+    {
+      if (wanted.erase(name) > 0)
+      {
+        shardSamples.push_back(name);
+      }
+    }
+    if (shardSamples.empty())
+    {
+      delete _shards[i];
+      continue;
+    }
+    _shards[i]->setSamples(shardSamples);
+    _shards[numKept] = _shards[i];
+    _paths[numKept] = _paths[i];
+    ++numKept;
+  }
+  _shards.resize(numKept);
+  _paths.resize(numKept);
+  _records.resize(numKept);
+  if (_shards.empty())
+  {
+    throw runtime_error("None of the given samples are in the VCFs");
+  }
+  if (!wanted.empty())
+  {
+    cerr << "Warning: " << wanted.size() << " of the given samples (eg "
+         << *wanted.begin() << ") are not in the VCFs" << endl;
+  }
+  mergeSampleNames();
+}
+
+void MergedGTReader::mergeSampleNames()
+{
+  _sampleNames.clear();
+  _duplicateError.clear();
+  map<string, size_t> shardOf;
+  for (size_t i = 0; i < _shards.size(); ++i)
+  {
+    for (auto& name : _shards[i]->getSampleNames())
+    {
+      if (!shardOf.insert(make_pair(name, i)).second &&
+          _duplicateError.empty())
+      {
+        _duplicateError = "Sample " + name + " is in both " +
+           _paths[shardOf[name]] + " and " + _paths[i];
+      }
+      _sampleNames.push_back(name);
+    }
+  }
+}
+
+GTReader* newGTReader(const string& path)
+{
+  if (path.find(',') != string::npos)
+  {
+    return new MergedGTReader();
+  }
+  if (path.length() > 4 && path.compare(path.length() - 4, 4, ".bcf") == 0)
+  {
+    return new BCFGTReader();
+  }
+  return new TextGTReader();
+}
+
+bool hasIndex(const string& path)
+{
+  return ifstream(path + ".tbi").good() || ifstream(path + ".csi").good();
+}
+
+ostream& operator<<(ostream& os, const VCFSite& site)
+{
+  os << site.sequenceName << ":" << site.position << " ";
+  for (int i = 0; i < site.alleles.size(); ++i)
+  {
+    os << (i == 0 ? "" : i == 1 ? " " : ",") << site.alleles[i];
+  }
+  return os;
+}
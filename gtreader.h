@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _GTREADER_H
+#define _GTREADER_H
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <cstring>
+#include <cstdlib>
+#include <zlib.h>
+
+#include "htslib/hts.h"
+#include "htslib/bgzf.h"
+#include "htslib/tbx.h"
+#include "htslib/vcf.h"
+
+/**
+The position and alleles of a vcf record: all we need to find it
+in the graph.
+*/
+struct VCFSite
+{
+   VCFSite() : position(0) {}
+   std::string sequenceName;
+   long position;
+   std::vector<std::string> alleles;
+};
+
+/**
+A vcf record reduced to its site and GT information.  Allele indices
+are stored in one flat buffer, sample-major with ploidy slots per
+sample, ie the allele on chromosome h of sample s is
+haplotypes[s * ploidy + h].  The buffer is reused from record to record.
+*/
+struct GTRecord : public VCFSite
+{
+   /** haplotype slot values for a . in the GT (Missing) and for slots
+    * beyond the sample's ploidy (Unused) */
+   enum Slot {Missing = -1, Unused = -2};
+
+   GTRecord() : ploidy(1), sampleNames(NULL) {}
+   int ploidy;
+   /** ploidy of each sample in this record.  0 means no GT */
+   std::vector<unsigned char> samplePloidy;
+   std::vector<int> haplotypes;
+   const std::vector<std::string>* sampleNames;
+};
+
+/**
+Interface for streaming GTRecords out of a variant file in order.
+*/
+class GTReader
+{
+public:
+   GTReader();
+   virtual ~GTReader();
+
+   /** open file and read its header.  throws runtime_error on failure */
+   virtual void open(const std::string& path) = 0;
+
+   /** read the next record.  returns false at end of file */
+   virtual bool getNextRecord(GTRecord& rec) = 0;
+
+   /** restrict subsequent reads to records overlapping
+    * sequenceName:[start, end] (1-based, inclusive) using the file's
+    * index.  returns false (and leaves reading as is) if there is no
+    * index. */
+   virtual bool setRegion(const std::string& sequenceName, long start,
+                          long end);
+
+   /** where the next record starts, to come back to with seek().  -1
+    * if that can't be done (reading a region) */
+   virtual int64_t tell();
+
+   /** carry on reading from an offset tell() gave for the same file.
+    * throws runtime_error on failure */
+   virtual void seek(int64_t offset);
+
+   /** only read the given samples (which needn't all be in the
+    * file).  records then have just these samples, in header order,
+    * and the other columns are skipped without being parsed.  call
+    * once, after open().  throws runtime_error if none are found */
+   virtual void setSamples(const std::vector<std::string>& samples);
+
+   /** sample names from the header, in column order */
+   const std::vector<std::string>& getSampleNames() const;
+
+protected:
+
+   std::vector<std::string> _sampleNames;
+   /** index in _sampleNames of each header column, -1 if the column
+    * isn't read.  empty if all columns are read.  trailing columns
+    * that aren't read are left off */
+   std::vector<int> _columnSample;
+};
+
+/**
+Reads plain or gzipped text vcf.  Only the CHROM, POS, REF and ALT
+columns and the GT subfield of each sample are looked at.  Everything
+else (INFO, other FORMAT fields) is skipped without being parsed.
+If the file is bgzipped with a tabix (or csi) index, setRegion() will
+seek straight to the region instead of scanning from the start.
+*/
+class TextGTReader : public GTReader
+{
+public:
+   TextGTReader();
+   virtual ~TextGTReader();
+
+   virtual void open(const std::string& path);
+   virtual bool getNextRecord(GTRecord& rec);
+   virtual bool setRegion(const std::string& sequenceName, long start,
+                          long end);
+   /** offsets are into the uncompressed text */
+   virtual int64_t tell();
+   virtual void seek(int64_t offset);
+
+protected:
+
+   /** point _lineStart, _lineEnd at the next line.  false if none */
+   bool readLine();
+
+   /** read the header up to and including the #CHROM line */
+   void readHeader();
+
+   /** parse the current line into rec */
+   void parseRecord(GTRecord& rec);
+
+   /** find position of GT within (colon-separated) format field */
+   void updateFormat(const char* start, const char* end);
+
+   /** change the number of haplotype slots per sample in rec */
+   static void setPloidy(GTRecord& rec, int ploidy);
+
+protected:
+
+   std::string _path;
+   gzFile _file;
+   bool _eof;
+   std::vector<char> _buffer;
+   size_t _bufPos;
+   size_t _bufEnd;
+   // only used when a line straddles two buffer reads
+   std::string _line;
+   const char* _lineStart;
+   const char* _lineEnd;
+   long _lineNumber;
+
+   std::string _format;
+   int _gtField;
+   int _ploidy;
+
+   // region iteration through the tabix index
+   htsFile* _htsFile;
+   tbx_t* _tbx;
+   hts_itr_t* _itr;
+   bool _inRegion;
+   kstring_t _kline;
+};
+
+/**
+Reads bcf natively through htslib.  No text is parsed at all: the
+alleles and the binary GT array are copied straight into the record.
+setRegion() uses the csi index if there is one.
+*/
+class BCFGTReader : public GTReader
+{
+public:
+   BCFGTReader();
+   virtual ~BCFGTReader();
+
+   virtual void open(const std::string& path);
+   virtual bool getNextRecord(GTRecord& rec);
+   virtual bool setRegion(const std::string& sequenceName, long start,
+                          long end);
+   /** offsets are bgzf virtual offsets */
+   virtual int64_t tell();
+   virtual void seek(int64_t offset);
+   virtual void setSamples(const std::vector<std::string>& samples);
+
+protected:
+
+   std::string _path;
+   htsFile* _file;
+   bcf_hdr_t* _header;
+   bcf1_t* _rec;
+   hts_idx_t* _idx;
+   hts_itr_t* _itr;
+   bool _inRegion;
+   int32_t* _gts;
+   int _gtsSize;
+};
+
+/**
+Reads several vcfs (shards) with the same sites in the same order but
+different samples as if they were one vcf with all their samples, like
+bcftools merge but without writing the merged file.  The shards are
+read in lockstep, each by its own reader, and every record is checked
+to be the same site in all of them.  Samples are in shard order, then
+header order within each shard.  Records come out with the largest
+ploidy of any shard.
+
+A merged vcf can be read by region if every shard is indexed, but
+can't tell() or seek(): a checkpoint is resumed from by reading
+through to it.
+*/
+class MergedGTReader : public GTReader
+{
+public:
+   MergedGTReader();
+   virtual ~MergedGTReader();
+
+   /** open each vcf in a comma-separated list of paths */
+   virtual void open(const std::string& path);
+   virtual bool getNextRecord(GTRecord& rec);
+   virtual bool setRegion(const std::string& sequenceName, long start,
+                          long end);
+   /** shards with none of the samples aren't read at all */
+   virtual void setSamples(const std::vector<std::string>& samples);
+
+protected:
+
+   /** _sampleNames from those of the shards.  a sample in more than one
+    * shard is only an error if it's still there when reading starts, so
+    * that --samples can pick one of the copies */
+   void mergeSampleNames();
+
+protected:
+
+   std::vector<GTReader*> _shards;
+   std::vector<std::string> _paths;
+   /** last record read from each shard */
+   std::vector<GTRecord> _records;
+   bool _indexed;
+   /** set by mergeSampleNames() if a sample is in two shards */
+   std::string _duplicateError;
+};
+
+/** a reader for path: bcf if it ends in .bcf, text otherwise, and
+ * merged if it's a comma-separated list.  not opened yet */
+GTReader* newGTReader(const std::string& path);
+
+/** true if an index file (.tbi or .csi) exists next to path */
+bool hasIndex(const std::string& path);
+
+std::ostream& operator<<(std::ostream& os, const VCFSite& site);
+
+#endif
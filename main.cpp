@@ -6,32 +6,214 @@
 
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <set>
+#include <memory>
 #include <getopt.h>
+#include <omp.h>
 
 #include "vg/src/vg.hpp"
-#include "Variant.h"
 
 #include "snpbridge.h"
+#include "bridgeplan.h"
+#include "graphwindow.h"
+#include "graphdelta.h"
+#include "gfa.h"
+#include "xgwindow.h"
+#include "renumber.h"
+#include "checkpoint.h"
 
-using namespace vcflib;
 using namespace vg;
 using namespace std;
 
 static const int DefaultWindowSize = 50;
+static const double DefaultCheckpointInterval = 10;
 
 void help_main(char** argv)
 {
   cerr << "usage: " << argv[0] << " [options] VGFILE VCFFILE" << endl
+       << "       " << argv[0] << " plan [options] VCFFILE PLANFILE" << endl
+       << "       " << argv[0] << " update [options] PLANFILE VCFFILE NEWPLAN"
+       << endl
+       << "       " << argv[0] << " apply [options] VGFILE PLANFILE" << endl
+       << "       " << argv[0] << " patch VGFILE DELTAFILE" << endl
        << "Pull apart adjacent snps when genotype information permits in"
        << " order to reduce number of paths that do not reflect haplotypes."
        << "\nThe input vg file must have been created from the input vcf file."
+       << "\nVCFFILE can be .vcf, .vcf.gz or .bcf.  If it is indexed (.tbi or"
+       << " .csi), only the\nregion covered by the graph is read."
+       << "\nVCFFILE can also be a comma-separated list of vcfs with the same"
+       << " sites but different\nsamples, which are read together as if"
+       << " merged."
+       << "\nplan writes all bridging decisions from VCFFILE to PLANFILE"
+       << " without needing a graph.\nupdate adds the genotypes of new samples"
+       << " in VCFFILE to the link\ncounts of PLANFILE (made with -C), and"
+       << " writes NEWPLAN with the bridges they give."
+       << "\napply makes the bridges in PLANFILE"
+       << " without reading any genotypes."
+       << "\npatch makes the edits in DELTAFILE (from -d) in VGFILE and writes"
+       << " the result."
+       << "\nVGFILE can be vg, GFA (if it ends in .gfa) or an xg index (.xg,"
+       << " always streamed)."
+       << "\nEvery path in the graph is processed, against the vcf records on"
+       << " the sequence\nof the same name."
        << endl
        << "options:" << endl
        << "    -h, --help          print this help message" << endl
        << "    -w, --window-size N maximum distance between adjacent snps to be"
        << " merged (default=" << DefaultWindowSize << ")" << endl
        << "    -o, --offset N      vcf-coordinate of first position in vg path"
-       << " (default=1)" << endl;
+       << " (default=1)" << endl
+       << "    -b, --offsets FILE  BED file giving the region each path was"
+       << " built from.\n                        overrides -o for the paths"
+       << " it lists" << endl
+       << "    -s, --stream        keep only a window of the vg file's chunks"
+       << " in memory\n                        (paths must be in the same"
+       << " order as in the vcf)" << endl
+       << "    -m, --samples FILE  only use the genotypes of the samples in FILE"
+       << " (first word of\n                        each line)" << endl
+       << "    -g, --population P  only use the lines of the samples file with"
+       << " P in a later\n                        column (eg a 1000 Genomes"
+       << " panel file)" << endl
+       << "    -t, --threads N     number of threads used to compare genotypes"
+       << " (default=1)" << endl
+       << "    -V, --verbosity N   warnings about the vcf: 0 = counts only,"
+       << " 1 = counts and a\n                        few examples, 2 = every"
+       << " warning (default=1)" << endl
+       << "    -C, --counts        keep link counts in the plan, so it can be"
+       << " updated with new\n                        samples (plan only)"
+       << endl
+       << "    -G, --gfa           write the output graph as GFA instead of vg"
+       << endl
+       << "    -k, --keep-ids      don't renumber the nodes of the output graph"
+       << " (always kept\n                        with --stream or --delta)"
+       << endl
+       << "    -d, --delta FILE    write only the edits made to the graph to"
+       << " FILE (see patch),\n                        instead of the whole"
+       << " graph to stdout" << endl
+       << "    -c, --checkpoint F  save where the run has got to in F (and the"
+       << " edits so far in\n                        F.delta, unless -d is"
+       << " given) every so often" << endl
+       << "    -i, --interval N    minutes between checkpoints (default="
+       << DefaultCheckpointInterval << ")" << endl
+       << "    -r, --resume        carry on from the checkpoint in the file"
+       << " given with -c, if\n                        there is one (a"
+       << " gzipped vcf that isn't read by\n                        region"
+       << " is decompressed again up to it)" << endl
+       << "    -S, --stats FILE    write time spent in each stage, and counts"
+       << " of variants,\n                        bridges and edits, to FILE"
+       << " as JSON" << endl;
+}
+
+unique_ptr<GTReader> openVCF(const string& vcfFile,
+                             const vector<string>& samples)
+{
+  // We only ever look at the GT field, so use our own reader rather
+  // than parsing everything with vcflib
+  unique_ptr<GTReader> vcf(newGTReader(vcfFile));
+  vcf->open(vcfFile);
+  if (!samples.empty())
+  {
+    vcf->setSamples(samples);
+  }
+  return vcf;
+}
+
+/** read sample names from the first column of a file.  if population
+ * isn't empty, only lines with it in another column are used */
+vector<string> readSamples(const string& samplesFile,
+                           const string& population)
+{
+  ifstream samplesStream(samplesFile);
+  if (!samplesStream.good())
+  {
+    stringstream ss;
+    ss << "Could not read " << samplesFile;
+    throw runtime_error(ss.str());
+  }
+  vector<string> samples;
+  string line;
+  while (getline(samplesStream, line))
+  {
+    stringstream ls(line);
+    string name;
+    if (!(ls >> name) || name[0] == '#')
+    {
+      continue;
+    }
+    bool inPopulation = population.empty();
+    for (string column; !inPopulation && ls >> column;)
+    {
+      inPopulation = column == population;
+    }
+    if (inPopulation)
+    {
+      samples.push_back(name);
+    }
+  }
+  if (samples.empty())
+  {
+    stringstream ss;
+    ss << "No samples found in " << samplesFile;
+    if (!population.empty())
+    {
+      ss << " for population " << population;
+    }
+    throw runtime_error(ss.str());
+  }
+  return samples;
+}
+
+/** read a BED file of path regions into a map of (1-based) path offsets */
+map<string, int> readOffsets(const string& bedFile)
+{
+  ifstream bedStream(bedFile);
+  if (!bedStream.good())
+  {
+    stringstream ss;
+    ss << "Could not read " << bedFile;
+    throw runtime_error(ss.str());
+  }
+  map<string, int> offsets;
+  string line;
+  while (getline(bedStream, line))
+  {
+    if (line.empty() || line[0] == '#' || line.compare(0, 5, "track") == 0)
+    {
+      continue;
+    }
+    stringstream ls(line);
+    string name;
+    long start;
+    if (!(ls >> name >> start))
+    {
+      stringstream ss;
+      ss << "Error parsing line \"" << line << "\" of " << bedFile;
+      throw runtime_error(ss.str());
+    }
+    offsets[name] = start + 1;
+  }
+  return offsets;
+}
+
+/** add up total time and write stats as JSON (if a file was given) */
+void writeStats(Stats& stats, const string& statsFile,
+                chrono::steady_clock::time_point start)
+{
+  stats.addTime(Stats::Total, chrono::duration<double>(
+                  chrono::steady_clock::now() - start).count());
+  if (statsFile.empty())
+  {
+    return;
+  }
+  ofstream statsStream(statsFile);
+  if (!statsStream.good())
+  {
+    stringstream ss;
+    ss << "Could not write " << statsFile;
+    throw runtime_error(ss.str());
+  }
+  stats.writeJSON(statsStream);
 }
 
 int main(int argc, char** argv) {
@@ -44,20 +226,57 @@ int main(int argc, char** argv) {
 
   int windowSize = DefaultWindowSize;
   int offset = 1;
+  int threads = 1;
+  string offsetsFile;
+  string statsFile;
+  string deltaFile;
+  string checkpointFile;
+  double checkpointInterval = DefaultCheckpointInterval;
+  bool resume = false;
+  string samplesFile;
+  string population;
+  bool stream = false;
+  bool gfa = false;
+  bool keepIds = false;
+  bool keepCounts = false;
+  int verbosity = Diagnostics::Summary;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  // optional subcommand
+  string command;
+  if (string(argv[1]) == "plan" || string(argv[1]) == "update" ||
+      string(argv[1]) == "apply" || string(argv[1]) == "patch")
+  {
+    command = argv[1];
+  }
     
-  optind = 1; // Start at first real argument
+  optind = command.empty() ? 1 : 2; // Start at first real argument
   bool optionsRemaining = true;
   while(optionsRemaining) {
     static struct option longOptions[] = {
       {"window-size", required_argument, 0, 'w'},
       {"offset", required_argument, 0, 'o'},
+      {"offsets", required_argument, 0, 'b'},
+      {"stream", no_argument, 0, 's'},
+      {"samples", required_argument, 0, 'm'},
+      {"population", required_argument, 0, 'g'},
+      {"threads", required_argument, 0, 't'},
+      {"verbosity", required_argument, 0, 'V'},
+      {"counts", no_argument, 0, 'C'},
+      {"gfa", no_argument, 0, 'G'},
+      {"keep-ids", no_argument, 0, 'k'},
+      {"delta", required_argument, 0, 'd'},
+      {"checkpoint", required_argument, 0, 'c'},
+      {"interval", required_argument, 0, 'i'},
+      {"resume", no_argument, 0, 'r'},
+      {"stats", required_argument, 0, 'S'},
       {"help", no_argument, 0, 'h'},
       {0, 0, 0, 0}
     };
 
     int optionIndex = 0;
 
-    switch(getopt_long(argc, argv, "w:o:h", longOptions, &optionIndex)) {
+    switch(getopt_long(argc, argv, "w:o:b:sm:g:t:V:CGkd:c:i:rS:h", longOptions, &optionIndex)) {
       // Option value is in global optarg
     case -1:
       optionsRemaining = false;
@@ -68,6 +287,48 @@ int main(int argc, char** argv) {
     case 'o':
       offset = atol(optarg);
       break;
+    case 'b':
+      offsetsFile = optarg;
+      break;
+    case 's':
+      stream = true;
+      break;
+    case 'm':
+      samplesFile = optarg;
+      break;
+    case 'g':
+      population = optarg;
+      break;
+    case 't':
+      threads = atol(optarg);
+      break;
+    case 'V':
+      verbosity = atol(optarg);
+      break;
+    case 'C':
+      keepCounts = true;
+      break;
+    case 'G':
+      gfa = true;
+      break;
+    case 'k':
+      keepIds = true;
+      break;
+    case 'd':
+      deltaFile = optarg;
+      break;
+    case 'c':
+      checkpointFile = optarg;
+      break;
+    case 'i':
+      checkpointInterval = atof(optarg);
+      break;
+    case 'r':
+      resume = true;
+      break;
+    case 'S':
+      statsFile = optarg;
+      break;
     case 'h': // When the user asks for help
       help_main(argv);
       exit(1);
@@ -78,44 +339,291 @@ int main(int argc, char** argv) {
     }
   }
 
-  if(argc - optind < 2) {
-    // We don't have two positional arguments
+  if(argc - optind < (command == "update" ? 3 : 2)) {
+    // We don't have enough positional arguments
     // Print the help
     help_main(argv);
     return 1;
   }
 
-  string vgFile = argv[optind++];
-  string vcfFile = argv[optind++]; 
+  string inFile = argv[optind++];
+  string outFile = argv[optind++];
+  string newPlanFile = command == "update" ? argv[optind++] : "";
+
+  if (threads < 1)
+  {
+    cerr << "--threads must be at least 1" << endl;
+    return 1;
+  }
+  if (!population.empty() && samplesFile.empty())
+  {
+    cerr << "--population requires --samples" << endl;
+    return 1;
+  }
+  if (command == "patch" && (stream || !deltaFile.empty()))
+  {
+    cerr << "patch can't be used with --stream or --delta" << endl;
+    return 1;
+  }
+  if (keepCounts && command != "plan")
+  {
+    cerr << "--counts can only be used with plan" << endl;
+    return 1;
+  }
+  // an xg index is only ever read a window at a time
+  if (command != "plan" && command != "update" && isXG(inFile))
+  {
+    stream = true;
+  }
+  if (command == "patch" && isXG(inFile))
+  {
+    cerr << "patch needs a vg or GFA file, not xg" << endl;
+    return 1;
+  }
+  if (command != "plan" && command != "update" && stream && isGFA(inFile))
+  {
+    cerr << "--stream needs a vg file, not GFA" << endl;
+    return 1;
+  }
+  if (!checkpointFile.empty() && (!command.empty() || stream))
+  {
+    cerr << "--checkpoint can't be used with " << (stream ? "--stream" :
+                                                   command) << endl;
+    return 1;
+  }
+  if (resume && checkpointFile.empty())
+  {
+    cerr << "--resume requires --checkpoint" << endl;
+    return 1;
+  }
+  vector<string> samples;
+  if (!samplesFile.empty())
+  {
+    samples = readSamples(samplesFile, population);
+  }
+
+  omp_set_num_threads(threads);
+  SNPBridge snpBridge;
+  snpBridge.setNumThreads(threads);
+  snpBridge.getDiagnostics().setVerbosity(verbosity);
+  Stats& stats = snpBridge.getStats();
+  if (!offsetsFile.empty())
+  {
+    snpBridge.setPathOffsets(readOffsets(offsetsFile));
+  }
+
+  if (command == "plan")
+  {
+    unique_ptr<GTReader> vcf = openVCF(inFile, samples);
+    BridgePlanWriter plan;
+    plan.open(outFile, keepCounts ? &vcf->getSampleNames() : NULL);
+    snpBridge.makePlan(vcf.get(), offset, &plan);
+    plan.close();
+    writeStats(stats, statsFile, start);
+    return 0;
+  }
+
+  if (command == "update")
+  {
+    BridgePlanReader oldPlan;
+    oldPlan.open(inFile);
+    vector<string> counted = oldPlan.getCountedSamples();
+    if (counted.empty())
+    {
+      cerr << inFile << " has no link counts (make it with plan -C)" << endl;
+      return 1;
+    }
+    // counting a sample twice would make it look like more evidence
+    unique_ptr<GTReader> vcf = openVCF(outFile, samples);
+    set<string> old(counted.begin(), counted.end());
+    for (auto& name : vcf->getSampleNames())
+    {
+      if (old.count(name) > 0)
+      {
+        cerr << "Sample " << name << " is already counted in " << inFile
+             << endl;
+        return 1;
+      }
+      counted.push_back(name);
+    }
+    BridgePlanWriter newPlan;
+    newPlan.open(newPlanFile, &counted);
+    snpBridge.updatePlan(&oldPlan, vcf.get(), &newPlan);
+    newPlan.close();
+    writeStats(stats, statsFile, start);
+    return 0;
+  }
     
+  // a checkpoint gives the edits up to it in a log, which is the
+  // delta file if there is one
+  string logFile = deltaFile;
+  Checkpoint checkpoint;
+  bool resuming = false;
+  if (!checkpointFile.empty())
+  {
+    if (logFile.empty())
+    {
+      logFile = checkpointFile + ".delta";
+    }
+    resuming = resume && CheckpointReader().read(checkpointFile, checkpoint);
+    if (resuming && (checkpoint.graphFile != inFile ||
+                     checkpoint.vcfFile != outFile))
+    {
+      cerr << "Checkpoint " << checkpointFile << " is for "
+           << checkpoint.graphFile << " and " << checkpoint.vcfFile << endl;
+      return 1;
+    }
+  }
+
+  // the edits can be written as we go instead of the graph at the end
+  GraphDeltaWriter delta;
+  if (!logFile.empty())
+  {
+    if (resuming)
+    {
+      delta.reopen(logFile, checkpoint.logLength, checkpoint.logLastId);
+    }
+    else
+    {
+      delta.open(logFile);
+    }
+    snpBridge.setDeltaWriter(&delta);
+  }
+    
+  // the output graph, unless only the edits are wanted
+  GraphChunkWriter* writer = NULL;
+  if (deltaFile.empty())
+  {
+    writer = gfa ? new GFAWriter() : new GraphChunkWriter();
+  }
+
   // Open the vg file
-  ifstream vgStream(vgFile);
-  if(!vgStream.good())
+  GraphWindow* window = NULL;
+  VG* vg = NULL;
+  if (stream)
   {
-    cerr << "Could not read " << vgFile << endl;
-    exit(1);
+    // chunks are written to cout as soon as we're done with them
+    StageTimer timer(stats, Stats::GraphLoad);
+    if (writer != NULL)
+    {
+      writer->open(&cout);
+    }
+    window = isXG(inFile) ? new XGWindow() : new GraphWindow();
+    window->open(inFile, writer);
+    snpBridge.setGraphWindow(window);
+    vg = window->getGraph();
+  }
+  else if (isGFA(inFile))
+  {
+    StageTimer timer(stats, Stats::GraphLoad);
+    GFAReader gfaReader;
+    gfaReader.open(inFile);
+    vg = new VG();
+    gfaReader.read(vg);
+  }
+  else
+  {
+    ifstream vgStream(inFile);
+    if(!vgStream.good())
+    {
+      cerr << "Could not read " << inFile << endl;
+      exit(1);
+    }
+    StageTimer timer(stats, Stats::GraphLoad);
+    vg = new VG(vgStream);
   }
-  VG vg(vgStream);
 
-  // Open the vcf file
-  VariantCallFile vcf;
-  vcf.open(vcfFile);
+  if (command == "apply")
+  {
+    BridgePlanReader plan;
+    plan.open(outFile);
+    snpBridge.applyPlan(vg, &plan, offset, windowSize);
+  }
+  else if (command == "patch")
+  {
+    GraphDeltaReader patch;
+    patch.open(outFile);
+    StageTimer timer(stats, Stats::BridgeEditing);
+    patch.apply(vg);
+  }
+  else
+  {
+    unique_ptr<GTReader> vcf = openVCF(outFile, samples);
+    if (resuming && checkpoint.samples != vcf->getSampleNames())
+    {
+      // the link counts of the rest of the run would be of other samples
+      cerr << "Checkpoint " << checkpointFile << " was made reading "
+           << checkpoint.samples.size() << " samples, not these "
+           << vcf->getSampleNames().size() << " (check --samples)" << endl;
+      return 1;
+    }
+    if (resuming)
+    {
+      // the graph as it was at the checkpoint
+      GraphDeltaReader log;
+      log.open(logFile);
+      StageTimer timer(stats, Stats::BridgeEditing);
+      log.apply(vg);
+      snpBridge.resumeFrom(checkpoint);
+    }
+    if (!checkpointFile.empty())
+    {
+      snpBridge.setCheckpoint(checkpointFile, checkpointInterval * 60,
+                              inFile, outFile, vcf->getSampleNames());
+    }
 
-  SNPBridge snpBridge;
+    // Process all adjacant variants my merging them in the graph
+    // when possible
+    snpBridge.processGraph(vg, vcf.get(), offset, windowSize);
+  }
 
-  // Process all adjacant variants my merging them in the graph
-  // when possible
-  snpBridge.processGraph(&vg, &vcf, offset, windowSize);
+  if (stream)
+  {
+    // write whatever's left
+    {
+      StageTimer timer(stats, Stats::Serialization);
+      window->close();
+    }
+    delta.close();
+    delete window;
+    delete writer;
+    writeStats(stats, statsFile, start);
+    return 0;
+  }
 
-  // Above inserts new nodes between existing nodes.  So we revise ids
-  // to be sorted
-  //vg.sort();
-  //vg.compact_ids();
+  // Above inserts new nodes between existing nodes, with ids after
+  // the largest.  So we revise ids to put them next to their neighbours
+  if (writer != NULL && !keepIds)
+  {
+    StageTimer timer(stats, Stats::Serialization);
+    NodeRenumberer renumberer;
+    renumberer.renumber(vg);
+  }
 
-  // output modified graph to cout
-  vg.serialize_to_ostream(cout);
+  // output modified graph to cout, unless we've already written
+  // the edits
+  if (writer != NULL)
+  {
+    StageTimer timer(stats, Stats::Serialization);
+    writer->open(&cout);
+    vg->serialize_to_function([writer](Graph& chunk) {
+        writer->writeChunk(chunk);
+      });
+    writer->close();
+  }
+  delta.close();
+  if (!checkpointFile.empty())
+  {
+    // done, so nothing to resume
+    remove(checkpointFile.c_str());
+    if (deltaFile.empty())
+    {
+      remove(logFile.c_str());
+    }
+  }
+  delete vg;
+  delete writer;
+  writeStats(stats, statsFile, start);
     
   return 0;
 }
-
-
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include "pathindex.h"
+
+using namespace vg;
+using namespace std;
+
+/** copy the sides in an edges_on_start or edges_on_end index for id,
+ * without adding an empty entry if it has none */
+template <typename T>
+static void copySides(const T& index, int64_t id,
+                      vector<pair<int64_t, bool> >& outSides)
+{
+  typename T::const_iterator i = index.find(id);
+  if (i == index.end())
+  {
+    outSides.clear();
+  }
+  else
+  {
+    outSides.assign(i->second.begin(), i->second.end());
+  }
+}
+
+/** forget the sides of the first numRemoved nodes in a flat list of
+ * them (see PathIndex::addExit()) */
+static void trimSides(vector<pair<int64_t, bool> >& exitSides,
+                      vector<size_t>& exitStarts, size_t numRemoved)
+{
+  size_t numSides = exitStarts[numRemoved];
+  exitSides.erase(exitSides.begin(), exitSides.begin() + numSides);
+  exitStarts.erase(exitStarts.begin(), exitStarts.begin() + numRemoved);
+  for (auto& start : exitStarts)
+  {
+    start -= numSides;
+  }
+}
+
+PathIndex::PathIndex() : _first(0), _offsets(1, 0), _altStarts(1, 0),
+                         _altExitStarts(1, 0), _exitStarts(1, 0)
+{
+}
+
+PathIndex::~PathIndex()
+{
+}
+
+void PathIndex::build(VG* vg, const string& pathName)
+{
+  if (vg->paths.has_path(pathName) == false)
+  {
+    stringstream ss;
+    ss << "Unable to find path for " << pathName << " in vg file";
+    throw runtime_error(ss.str());
+  }
+  init(pathName);
+  _offsets.reserve(vg->paths.get_path(pathName).size() + 1);
+  _nodes.reserve(vg->paths.get_path(pathName).size());
+  extend(vg);
+  _exits.reserve(_nodes.size());
+  _altStarts.reserve(_nodes.size() + 1);
+  _exitStarts.reserve(_nodes.size() + 1);
+  indexBubbles(vg, getNumNodes());
+}
+
+void PathIndex::init(const string& pathName)
+{
+  _name = pathName;
+  _first = 0;
+  _offsets.assign(1, 0);
+  _nodes.clear();
+  _altStarts.assign(1, 0);
+  _alts.clear();
+  _altExits.clear();
+  _exits.clear();
+  _altExitSides.clear();
+  _altExitStarts.assign(1, 0);
+  _exitSides.clear();
+  _exitStarts.assign(1, 0);
+}
+
+void PathIndex::extend(VG* vg)
+{
+  if (vg->paths.has_path(_name) == false)
+  {
+    return;
+  }
+  list<Mapping>& path = vg->paths.get_path(_name);
+  // everything still indexed is at the front of the path
+  list<Mapping>::iterator i = path.begin();
+  for (size_t j = 0; j < _nodes.size() && i != path.end(); ++j)
+  {
+    ++i;
+  }
+  for (; i != path.end(); ++i)
+  {
+    const Mapping& mapping = *i;
+    if (mapping.position().is_reverse() == true)
+    {
+      throw(runtime_error("Reverse Mapping not supported"));
+    }
+    if (mapping.edit_size() > 1 || (
+          mapping.edit_size() == 1 && mapping.edit(0).from_length() !=
+          mapping.edit(0).to_length()))
+    {
+      stringstream ss;
+      ss << pb2json(mapping) << ": Only mappings with a single trvial edit"
+         << " supported in ref path";
+      throw runtime_error(ss.str());
+    }
+    Node* node = vg->get_node(mapping.position().node_id());
+    _nodes.push_back(node);
+    _offsets.push_back(_offsets.back() + node->sequence().length());
+  }
+}
+
+void PathIndex::trim(VG* vg)
+{
+  size_t remaining = vg->paths.has_path(_name) ?
+     vg->paths.get_path(_name).size() : 0;
+  assert(remaining <= _nodes.size());
+  size_t numRemoved = _nodes.size() - remaining;
+  if (numRemoved > 0)
+  {
+    _nodes.erase(_nodes.begin(), _nodes.begin() + numRemoved);
+    _offsets.erase(_offsets.begin(), _offsets.begin() + numRemoved);
+    _first += numRemoved;
+
+    // and their bubbles, if they got that far
+    size_t numIndexed = min(numRemoved, _exits.size());
+    _exits.erase(_exits.begin(), _exits.begin() + numIndexed);
+    _altStarts.erase(_altStarts.begin(), _altStarts.begin() + numIndexed);
+    size_t numAlts = _altStarts.front();
+    _alts.erase(_alts.begin(), _alts.begin() + numAlts);
+    _altExits.erase(_altExits.begin(), _altExits.begin() + numAlts);
+    for (auto& start : _altStarts)
+    {
+      start -= numAlts;
+    }
+    trimSides(_exitSides, _exitStarts, numIndexed);
+    trimSides(_altExitSides, _altExitStarts, numAlts);
+  }
+}
+
+void PathIndex::indexBubbles(VG* vg, size_t last)
+{
+  last = min(last, getNumNodes());
+  for (size_t rank = _first + _exits.size(); rank < last; ++rank)
+  {
+    int64_t id = _nodes[rank - _first]->id();
+    copySides(vg->edges_on_end, id, _sides);
+    addExit(_sides, _exits, _exitSides, _exitStarts);
+
+    // an alt has all the same ways in, so it's attached to the same
+    // side of the first of them
+    copySides(vg->edges_on_start, id, _sides);
+    sort(_sides.begin(), _sides.end());
+    if (!_sides.empty())
+    {
+      int64_t prev = _sides.front().first;
+      bool fromStart = _sides.front().second;
+      copySides(fromStart ? vg->edges_on_start : vg->edges_on_end, prev,
+                _altSides);
+      _candidates.clear();
+      for (auto& side : _altSides)
+      {
+        if (side.second == fromStart && side.first != id)
+        {
+          _candidates.push_back(side.first);
+        }
+      }
+      for (auto candidate : _candidates)
+      {
+        copySides(vg->edges_on_start, candidate, _altSides);
+        sort(_altSides.begin(), _altSides.end());
+        if (_altSides == _sides)
+        {
+          _alts.push_back(vg->get_node(candidate));
+          copySides(vg->edges_on_end, candidate, _altSides);
+          addExit(_altSides, _altExits, _altExitSides, _altExitStarts);
+        }
+      }
+    }
+    _altStarts.push_back(_alts.size());
+  }
+}
+
+const string& PathIndex::getName() const
+{
+  return _name;
+}
+
+int64_t PathIndex::getLength() const
+{
+  return _offsets.back();
+}
+
+size_t PathIndex::getNumNodes() const
+{
+  return _first + _nodes.size();
+}
+
+size_t PathIndex::getFirstRank() const
+{
+  return _first;
+}
+
+int64_t PathIndex::find(int64_t pos) const
+{
+  if (pos < _offsets.front() || pos >= getLength())
+  {
+    return -1;
+  }
+  // first node starting after pos, then step back one
+  vector<int64_t>::const_iterator i =
+     upper_bound(_offsets.begin(), _offsets.end(), pos);
+  return _first + (i - _offsets.begin()) - 1;
+}
+
+int64_t PathIndex::getOffset(size_t rank) const
+{
+  return _offsets[rank - _first];
+}
+
+Node* PathIndex::getNode(size_t rank) const
+{
+  return _nodes[rank - _first];
+}
+
+void PathIndex::getNodes(size_t first, size_t last,
+                         vector<Node*>& outNodes) const
+{
+  outNodes.assign(_nodes.begin() + (first - _first),
+                  _nodes.begin() + (last - _first));
+}
+
+void PathIndex::getAlts(size_t rank, size_t& first, size_t& last) const
+{
+  if (rank < _first || rank - _first >= _exits.size())
+  {
+    first = last = 0;
+    return;
+  }
+  first = _altStarts[rank - _first];
+  last = _altStarts[rank - _first + 1];
+}
+
+Node* PathIndex::getAltNode(size_t i) const
+{
+  return _alts[i];
+}
+
+bool PathIndex::altEndsAt(size_t i, size_t rank) const
+{
+  if (rank < _first || rank - _first >= _exits.size() ||
+      _altExits[i] != _exits[rank - _first])
+  {
+    return false;
+  }
+  // same hash: make sure they're the same sides
+  size_t j = rank - _first;
+  size_t numSides = _exitStarts[j + 1] - _exitStarts[j];
+  return _altExitStarts[i + 1] - _altExitStarts[i] == numSides &&
+     equal(_exitSides.begin() + _exitStarts[j],
+           _exitSides.begin() + _exitStarts[j + 1],
+           _altExitSides.begin() + _altExitStarts[i]);
+}
+
+uint64_t PathIndex::sidesHash(vector<pair<int64_t, bool> >& sides) const
+{
+  sort(sides.begin(), sides.end());
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (auto& side : sides)
+  {
+    // splitmix64 finalizer on each side, so nearby ids don't collide
+    uint64_t x = ((uint64_t)side.first << 1) | side.second;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    hash = (hash ^ x) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+void PathIndex::addExit(vector<pair<int64_t, bool> >& sides,
+                        vector<uint64_t>& hashes,
+                        vector<pair<int64_t, bool> >& exitSides,
+                        vector<size_t>& exitStarts) const
+{
+  hashes.push_back(sidesHash(sides));
+  exitSides.insert(exitSides.end(), sides.begin(), sides.end());
+  exitStarts.push_back(exitSides.size());
+}
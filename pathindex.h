@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _PATHINDEX_H
+#define _PATHINDEX_H
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "vg/src/vg.hpp"
+
+/**
+Flat index of a reference path in the graph: the node at each rank
+of the path, and the path offset at which each one starts.  Built once
+in one pass, after which finding the node containing a position is a
+binary search, and the reference between two positions is a contiguous
+slice.
+
+When streaming (see GraphWindow), the index can also be grown from
+the back as chunks of the path are loaded and trimmed from the front
+as they are written out.  Ranks and offsets are always relative to
+the start of the whole path.
+
+The index also keeps a flat table of the bubbles hanging off the
+path (see indexBubbles()): for each rank, the nodes that have exactly
+the same ways in as the node at that rank (its alt alleles, in a graph
+from vg construct), and the ways out of each (hashed, so they're
+usually told apart without comparing them).  So the alleles of a
+variant are found with a couple of lookups instead of building and
+intersecting sets of siblings in the graph.
+
+Note: Only paths of forward mappings with (at most) one trivial edit
+are supported.
+*/
+
+class PathIndex
+{
+public:
+
+   PathIndex();
+   ~PathIndex();
+
+   /** index named path, and its bubbles.  throws runtime_error if it's
+    * not in graph */
+   void build(vg::VG* vg, const std::string& pathName);
+
+   /** start an empty index for the named path */
+   void init(const std::string& pathName);
+
+   /** index any mappings that have been appended to the path in the
+    * graph since the last call */
+   void extend(vg::VG* vg);
+
+   /** forget the nodes whose mappings have been removed from the front
+    * of the path in the graph */
+   void trim(vg::VG* vg);
+
+   /** find the alt nodes of every rank before last that doesn't have
+    * them yet, in one pass.  the nodes around them (the ones before
+    * each rank, and everything attached to them) must be in the graph.
+    * the table isn't updated as the graph is edited: it's the bubbles
+    * of the graph as it was built */
+   void indexBubbles(vg::VG* vg, size_t last);
+
+   /** name of the indexed path (empty if nothing indexed) */
+   const std::string& getName() const;
+
+   /** number of bases along the path */
+   int64_t getLength() const;
+
+   /** number of nodes along the path (ie rank after the last one) */
+   size_t getNumNodes() const;
+
+   /** rank of the first node still in the index */
+   size_t getFirstRank() const;
+
+   /** rank of the node that contains 0-based path position pos.
+    * -1 if pos is not on the path */
+   int64_t find(int64_t pos) const;
+
+   /** 0-based path position of the first base of the node at rank */
+   int64_t getOffset(size_t rank) const;
+
+   /** node at rank */
+   vg::Node* getNode(size_t rank) const;
+
+   /** get the nodes with ranks in [first, last) */
+   void getNodes(size_t first, size_t last,
+                 std::vector<vg::Node*>& outNodes) const;
+
+   /** the alt nodes at rank are getAltNode(i) for i in [first, last).
+    * empty if rank's bubble isn't indexed */
+   void getAlts(size_t rank, size_t& first, size_t& last) const;
+
+   /** alt node i */
+   vg::Node* getAltNode(size_t i) const;
+
+   /** does alt node i have the same ways out as the node at rank */
+   bool altEndsAt(size_t i, size_t rank) const;
+
+protected:
+
+   /** signature of a node's edges on one side: a hash of its sorted
+    * list of sides */
+   uint64_t sidesHash(std::vector<std::pair<int64_t, bool> >& sides) const;
+
+   /** add sides (sorted by sidesHash()) to the end of a flat list of
+    * them, with the hash, for one more node */
+   void addExit(std::vector<std::pair<int64_t, bool> >& sides,
+                std::vector<uint64_t>& hashes,
+                std::vector<std::pair<int64_t, bool> >& exitSides,
+                std::vector<size_t>& exitStarts) const;
+
+protected:
+
+   std::string _name;
+   /** rank of _nodes[0] */
+   size_t _first;
+   /** _offsets[i] is the start of node _first + i.  one extra at end
+    * for length */
+   std::vector<int64_t> _offsets;
+   std::vector<vg::Node*> _nodes;
+   /** _altStarts[i] is the start in _alts of the alt nodes of node
+    * _first + i.  one extra at end, so it's one longer than the number
+    * of ranks with their bubbles indexed */
+   std::vector<size_t> _altStarts;
+   std::vector<vg::Node*> _alts;
+   /** signature of the ways out of each alt */
+   std::vector<uint64_t> _altExits;
+   /** signature of the ways out of each indexed rank */
+   std::vector<uint64_t> _exits;
+   /** the sorted ways out of alt i (and of rank _first + i) are
+    * _altExitSides (_exitSides) from _altExitStarts[i] (_exitStarts[i])
+    * to the next start.  compared when the signatures match, as they
+    * could collide */
+   std::vector<std::pair<int64_t, bool> > _altExitSides;
+   std::vector<size_t> _altExitStarts;
+   std::vector<std::pair<int64_t, bool> > _exitSides;
+   std::vector<size_t> _exitStarts;
+   std::vector<std::pair<int64_t, bool> > _sides;
+   std::vector<std::pair<int64_t, bool> > _altSides;
+   std::vector<int64_t> _candidates;
+};
+
+#endif
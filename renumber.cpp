@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include <algorithm>
+#include <functional>
+
+#include "renumber.h"
+
+using namespace vg;
+using namespace std;
+
+NodeRenumberer::NodeRenumberer() : _vg(NULL)
+{
+}
+
+NodeRenumberer::~NodeRenumberer()
+{
+}
+
+void NodeRenumberer::renumber(VG* vg)
+{
+  _vg = vg;
+  computeOrder();
+  applyOrder();
+  _order.clear();
+  _newIds.clear();
+  _pathIds.clear();
+  _vg = NULL;
+}
+
+void NodeRenumberer::computeOrder()
+{
+  _order.clear();
+  _newIds.clear();
+  _order.reserve(_vg->graph.node_size());
+  _newIds.reserve(_vg->graph.node_size());
+
+  // path nodes get placed in path order, so don't let the search
+  // from another path node wander into them
+  _pathIds.clear();
+  function<void(Path&)> lambda = [&](Path& path)
+  {
+    for (int i = 0; i < path.mapping_size(); ++i)
+    {
+      _pathIds.push_back(path.mapping(i).position().node_id());
+    }
+  };
+  _vg->paths.for_each(lambda);
+  for (auto id : _pathIds)
+  {
+    _newIds[id] = 0;
+  }
+  for (auto id : _pathIds)
+  {
+    if (_newIds[id] == 0)
+    {
+      place(id);
+    }
+  }
+  // whatever no path leads to
+  for (int i = 0; i < _vg->graph.node_size(); ++i)
+  {
+    int64_t id = _vg->graph.node(i).id();
+    unordered_map<int64_t, int64_t>::iterator n = _newIds.find(id);
+    if (n == _newIds.end() || n->second == 0)
+    {
+      place(id);
+    }
+  }
+}
+
+void NodeRenumberer::place(int64_t id)
+{
+  _stack.clear();
+  _stack.push_back(id);
+  while (!_stack.empty())
+  {
+    int64_t next = _stack.back();
+    _stack.pop_back();
+    unordered_map<int64_t, int64_t>::iterator n = _newIds.find(next);
+    if (n != _newIds.end() && (n->second != 0 || next != id))
+    {
+      // already placed, or a path node waiting its turn
+      continue;
+    }
+    if (next != id && waitsForPath(next))
+    {
+      // it's placed from its own path node when we get there
+      continue;
+    }
+    _order.push_back(next);
+    _newIds[next] = _order.size();
+
+    // only go forward, so that nodes follow what leads into them and
+    // not (through a bridge) the previous variant
+    _neighbours.clear();
+    auto e = _vg->edges_on_end.find(next);
+    if (e != _vg->edges_on_end.end())
+    {
+      for (auto& side : e->second)
+      {
+        _neighbours.push_back(side.first);
+      }
+    }
+    // smallest id is visited first
+    sort(_neighbours.begin(), _neighbours.end(), greater<int64_t>());
+    for (auto neighbour : _neighbours)
+    {
+      if (_newIds.find(neighbour) == _newIds.end())
+      {
+        _stack.push_back(neighbour);
+      }
+    }
+  }
+}
+
+bool NodeRenumberer::waitsForPath(int64_t id) const
+{
+  // an alt allele of the next variant is reached from the bridges
+  // into it before the path node just before it
+  auto e = _vg->edges_on_start.find(id);
+  if (e != _vg->edges_on_start.end())
+  {
+    for (auto& side : e->second)
+    {
+      unordered_map<int64_t, int64_t>::const_iterator n =
+         _newIds.find(side.first);
+      if (n != _newIds.end() && n->second == 0)
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void NodeRenumberer::applyOrder()
+{
+  Graph& graph = _vg->graph;
+  for (int i = 0; i < graph.node_size(); ++i)
+  {
+    Node* node = graph.mutable_node(i);
+    node->set_id(_newIds[node->id()]);
+  }
+  // put node k + 1 at index k by following the cycles of the
+  // permutation: every swap puts at least one node in its place
+  for (int i = 0; i < graph.node_size(); ++i)
+  {
+    while (graph.node(i).id() != i + 1)
+    {
+      graph.mutable_node()->SwapElements(i, graph.node(i).id() - 1);
+    }
+  }
+  for (int i = 0; i < graph.edge_size(); ++i)
+  {
+    Edge* edge = graph.mutable_edge(i);
+    edge->set_from(_newIds[edge->from()]);
+    edge->set_to(_newIds[edge->to()]);
+  }
+  for (int i = 0; i < graph.path_size(); ++i)
+  {
+    Path* path = graph.mutable_path(i);
+    for (int j = 0; j < path->mapping_size(); ++j)
+    {
+      Position* position = path->mutable_mapping(j)->mutable_position();
+      position->set_node_id(_newIds[position->node_id()]);
+    }
+  }
+  // rebuild the paths rather than edit them in place, so any index
+  // they keep by node goes with them
+  Graph paths;
+  _vg->paths.to_graph(paths);
+  for (int i = 0; i < paths.path_size(); ++i)
+  {
+    Path* path = paths.mutable_path(i);
+    for (int j = 0; j < path->mapping_size(); ++j)
+    {
+      Position* position = path->mutable_mapping(j)->mutable_position();
+      position->set_node_id(_newIds[position->node_id()]);
+    }
+  }
+  _vg->paths.clear();
+  _vg->paths.append(paths);
+  _vg->rebuild_indexes();
+}
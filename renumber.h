@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _RENUMBER_H
+#define _RENUMBER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "vg/src/vg.hpp"
+
+/**
+Give the nodes of a graph new ids 1..n so that nodes near each other
+in the graph are near each other in id (and serialization) order.
+Bridge nodes are made with ids after the largest in the graph, so
+without this they'd all end up far from the reference they copy.
+
+Nodes are numbered in the order they're found walking each path, and
+right after each path node come the nodes off the paths (alt alleles,
+bridge copies) that can be reached from it by following edges off
+their ends without going through another path node.  So a bridge copy
+follows the allele it leaves from.  A node with an edge into it from a
+path node isn't placed until that path node is, so in a chain of
+bridges each alt allele still goes with its own reference segment
+rather than after the first variant of the chain.  Nodes that can't
+be reached that way go at the end, in their old order.  Neighbours are
+visited in order of old id, so the numbering depends only on the graph
+and not on the order its edges were made in.
+
+Everything is linear in the size of the graph, except sorting each
+node's (handful of) neighbours.  Edges and path mappings are rewritten
+with the new ids, and the node list is put in id order.
+*/
+class NodeRenumberer
+{
+public:
+   NodeRenumberer();
+   ~NodeRenumberer();
+
+   /** renumber the nodes of vg in place */
+   void renumber(vg::VG* vg);
+
+protected:
+
+   /** fill _order with the old ids in their new order */
+   void computeOrder();
+
+   /** add id to the order, followed by the off-path nodes it leads to */
+   void place(int64_t id);
+
+   /** does an off-path node have an edge into it from a path node that
+    * hasn't been placed yet */
+   bool waitsForPath(int64_t id) const;
+
+   /** rewrite the graph with the new ids */
+   void applyOrder();
+
+protected:
+
+   vg::VG* _vg;
+   std::vector<int64_t> _order;
+   /** node ids of all the paths, in path order */
+   std::vector<int64_t> _pathIds;
+   /** new id of each old id.  0 for path nodes not placed yet */
+   std::unordered_map<int64_t, int64_t> _newIds;
+   std::vector<int64_t> _stack;
+   std::vector<int64_t> _neighbours;
+};
+
+#endif
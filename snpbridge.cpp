@@ -5,12 +5,18 @@
  */
 
 #include "snpbridge.h"
+#include "bridgeplan.h"
+#include "graphwindow.h"
+#include "graphdelta.h"
 
-using namespace vcflib;
 using namespace vg;
 using namespace std;
 
-SNPBridge::SNPBridge() : _vg(NULL)
+SNPBridge::SNPBridge() : _vg(NULL), _window(NULL), _delta(NULL),
+                         _defaultOffset(1), _havePending(false),
+                         _blockSize(1), _blockStart(0),
+                         _keepCounts(false), _checkpointInterval(0),
+                         _resuming(false)
 {
 }
 
@@ -18,145 +24,1032 @@ SNPBridge::~SNPBridge()
 {
 }
 
-void SNPBridge::processGraph(VG* vg, VariantCallFile* vcf, int offset,
-                            int windowSize)
+void SNPBridge::setNumThreads(int numThreads)
+{
+  // one pair at a time keeps the log output in exactly the same order
+  // as it's always been.  with threads, we read a block of pairs and
+  // classify them all at once.
+  _blockSize = numThreads > 1 ? ParallelBlockSize : 1;
+}
+
+void SNPBridge::setGraphWindow(GraphWindow* window)
+{
+  _window = window;
+}
+
+void SNPBridge::setDeltaWriter(GraphDeltaWriter* delta)
+{
+  _delta = delta;
+  _edits.setDeltaWriter(delta);
+}
+
+void SNPBridge::setCheckpoint(const string& path, double interval,
+                              const string& graphFile, const string& vcfFile,
+                              const vector<string>& samples)
+{
+  _checkpointPath = path;
+  _checkpointInterval = interval;
+  _checkpoint.graphFile = graphFile;
+  _checkpoint.vcfFile = vcfFile;
+  _checkpoint.samples = samples;
+}
+
+void SNPBridge::resumeFrom(const Checkpoint& checkpoint)
+{
+  _checkpoint = checkpoint;
+  _resuming = true;
+}
+
+Stats& SNPBridge::getStats()
+{
+  return _stats;
+}
+
+Diagnostics& SNPBridge::getDiagnostics()
+{
+  return _diagnostics;
+}
+
+void SNPBridge::setPathOffsets(const map<string, int>& offsets)
+{
+  _offsets = offsets;
+}
+
+void SNPBridge::processGraph(VG* vg, GTReader* vcf, int offset,
+                             int windowSize)
 {
   _vg = vg;
-  _gv1.init(offset);
-  _gv2.init(offset);
-  
-  Variant var1(*vcf);
-  Variant var2(*vcf);
-  // skip to first variant after offset
-  for (int vcfPos = -1; vcfPos < offset; vcfPos = var1.position)
+  _edits.init(vg);
+  _defaultOffset = offset;
+  _pathIndexes.clear();
+  _havePending = false;
+  initBlock();
+
+  vector<string> pathNames;
+  getPathNames(pathNames);
+  _lastCheckpoint = chrono::steady_clock::now();
+  if (!_resuming)
+  {
+    _checkpoint.donePaths.clear();
+  }
+  // paths finished before the checkpoint we're resuming
+  set<string> done(_checkpoint.donePaths.begin(),
+                   _checkpoint.donePaths.end());
+
+  // if the vcf is indexed, jump straight to the interval covered by
+  // each path rather than reading through everything in between
+  size_t numIndexed = 0;
+  for (auto& pathName : pathNames)
+  {
+    int pathOffset = getOffset(pathName);
+    if (!vcf->setRegion(pathName, pathOffset,
+                        pathOffset + getPathLength(pathName) - 1))
+    {
+      if (numIndexed == 0)
+      {
+        // no index: read it all below
+        break;
+      }
+      // we're part way through the file, so can't go back to scanning
+      // it.  carry on with the other paths
+      cerr << "Warning: could not read the variants of " << pathName
+           << " by region, so it is skipped" << endl;
+      continue;
+    }
+    ++numIndexed;
+    if (done.count(pathName) == 0)
+    {
+      processSequence(vcf, pathName, windowSize);
+      _checkpoint.donePaths.push_back(pathName);
+    }
+    _havePending = false;
+  }
+  if (numIndexed > 0)
+  {
+    _diagnostics.report(cerr);
+    reportSavings();
+    return;
+  }
+
+  // otherwise, one pass through the (sorted) vcf, switching paths
+  // whenever the sequence changes
+  if (_resuming)
+  {
+    // starting from the path we were on at the checkpoint
+    string sequenceName = _checkpoint.site.sequenceName;
+    processSequence(vcf, sequenceName, windowSize);
+    done.insert(sequenceName);
+    _checkpoint.donePaths.push_back(sequenceName);
+  }
+  GTRecord rec;
+  while (done.size() < pathNames.size() && nextRecord(vcf, rec))
+  {
+    string sequenceName = rec.sequenceName;
+    pushBack(rec);
+    if (done.count(sequenceName) == 0 && hasPath(sequenceName) == true)
+    {
+      processSequence(vcf, sequenceName, windowSize);
+      done.insert(sequenceName);
+      _checkpoint.donePaths.push_back(sequenceName);
+    }
+    else
+    {
+      if (done.count(sequenceName) == 0)
+      {
+        cerr << "Skipping variants on " << sequenceName << " because there"
+             << " is no path for it in vg file" << endl;
+      }
+      while (nextRecord(vcf, rec))
+      {
+        if (rec.sequenceName != sequenceName)
+        {
+          pushBack(rec);
+          break;
+        }
+      }
+    }
+  }
+  _diagnostics.report(cerr);
+  reportSavings();
+}
+
+void SNPBridge::processSequence(GTReader* vcf, const string& sequenceName,
+                                int windowSize)
+{
+  const PathIndex& path = indexPath(sequenceName);
+  int offset = getOffset(sequenceName);
+
+  GTRecord rec;
+  bool resuming = _resuming && _checkpoint.site.sequenceName == sequenceName;
+  if (resuming)
+  {
+    resumeSequence(vcf, offset, rec);
+  }
+  else if (!readFirstVariant(vcf, sequenceName, offset, rec))
+  {
+    cerr << "No variants found in VCF for " << sequenceName << endl;
+    finishSequence(sequenceName);
+    return;
+  }
+
+  // slot 0 of the block always holds the last variant of the previous
+  // block (which is in _gv1)
+  _sites[0] = rec;
+  _gv1.init(&path, offset);
+  _gv2.init(&path, offset);
+  fetchVariant(_sites[0]);
+  if (resuming)
+  {
+    // its alleles may have been bridged to already, so they can't be
+    // looked up as bubbles any more
+    _gv1.loadVariant(_vg, _sites[0], _checkpoint.alleleIds);
+    _resuming = false;
+  }
+  else
+  {
+    _gv1.loadVariant(_vg, _sites[0]);
+  }
+  loadRow(0, rec);
+
+  int graphLen = getPathLength(sequenceName);
+
+  bool more = true;
+  while (more)
+  {
+    int numRead = 0;
+    more = readBlock(vcf, offset + graphLen, rec, numRead);
+    decideBlock(numRead, windowSize);
+    applyBlock(numRead);
+    swap(_sites[0], _sites[numRead]);
+    _blockStart += numRead;
+    if (more)
+    {
+      saveCheckpoint(vcf, rec);
+    }
+  }
+  finishSequence(sequenceName);
+}
+
+void SNPBridge::resumeSequence(GTReader* vcf, int offset, GTRecord& rec)
+{
+  const GTRecord& site = _checkpoint.site;
+  if (_checkpoint.vcfOffset >= 0 && vcf->tell() >= 0)
+  {
+    // straight to the record after the site
+    vcf->seek(_checkpoint.vcfOffset);
+  }
+  else
+  {
+    // read through to the site: from it if we're reading by region.
+    // a kept variant is always the first at its position
+    if (vcf->tell() < 0)
+    {
+      vcf->setRegion(site.sequenceName, site.position,
+                     offset + getPathLength(site.sequenceName) - 1);
+    }
+    do
+    {
+      if (!nextRecord(vcf, rec))
+      {
+        stringstream ss;
+        ss << "Variant " << site << " of checkpoint not found in vcf";
+        throw runtime_error(ss.str());
+      }
+    }
+    while (rec.sequenceName != site.sequenceName ||
+           rec.position != site.position || rec.alleles != site.alleles);
+  }
+  rec = site;
+  rec.sampleNames = &vcf->getSampleNames();
+  cerr << "Resuming from checkpoint at " << site << endl;
+}
+
+void SNPBridge::saveCheckpoint(GTReader* vcf, const GTRecord& rec)
+{
+  if (_checkpointPath.empty() ||
+      chrono::duration<double>(chrono::steady_clock::now() -
+                               _lastCheckpoint).count() < _checkpointInterval)
+  {
+    return;
+  }
+  assert(_delta != NULL && !_havePending);
+  // everything up to _sites[0] has to be in the log
+  applyEdits();
+  _checkpoint.site = rec;
+  _gv1.getAlleleIds(_checkpoint.alleleIds);
+  _checkpoint.vcfOffset = vcf->tell();
+  _checkpoint.logLength = _delta->tell();
+  _checkpoint.logLastId = _delta->getLastId();
+  CheckpointWriter writer;
+  writer.write(_checkpointPath, _checkpoint);
+  _lastCheckpoint = chrono::steady_clock::now();
+}
+
+void SNPBridge::makePlan(GTReader* vcf, int offset, BridgePlanWriter* plan)
+{
+  _defaultOffset = offset;
+  _havePending = false;
+  _keepCounts = plan->hasCounts();
+  initBlock();
+
+  GTRecord rec;
+  while (nextRecord(vcf, rec))
+  {
+    string sequenceName = rec.sequenceName;
+    pushBack(rec);
+    if (!readFirstVariant(vcf, sequenceName, getOffset(sequenceName), rec))
+    {
+      continue;
+    }
+    _sites[0] = rec;
+    loadRow(0, rec);
+    plan->writeSite(_sites[0], vector<BridgeDecision>());
+
+    bool more = true;
+    while (more)
+    {
+      int numRead = 0;
+      more = readBlock(vcf, numeric_limits<int>::max(), rec, numRead);
+      // the window size is only checked when the plan is applied, so
+      // decide every pair
+      decideBlock(numRead, numeric_limits<int>::max());
+      for (int k = 1; k <= numRead; ++k)
+      {
+        if (!_decisions[k].error.empty())
+        {
+          throw runtime_error(_decisions[k].error);
+        }
+        cerr << _decisions[k].log;
+        for (auto& bridge : _decisions[k].bridges)
+        {
+          _stats.countBridge(bridge.phase);
+        }
+        plan->writeSite(_sites[k], _decisions[k].bridges,
+                        _keepCounts ? &_decisions[k].counts : NULL);
+      }
+      swap(_sites[0], _sites[numRead]);
+      _blockStart += numRead;
+    }
+  }
+  _keepCounts = false;
+  _diagnostics.report(cerr);
+}
+
+void SNPBridge::updatePlan(BridgePlanReader* oldPlan, GTReader* vcf,
+                           BridgePlanWriter* newPlan)
+{
+  _havePending = false;
+  initBlock();
+
+  // pairs are redecided one at a time: everything we need from the
+  // old samples is in their counts
+  VCFSite site;
+  VCFSite prev;
+  vector<BridgeDecision> oldBridges;
+  LinkCounts oldCounts;
+  LinkCounts newCounts;
+  PairDecision decision;
+  GTRecord rec;
+  size_t numPairs = 0;
+  size_t numChanged = 0;
+  size_t numSkipped = 0;
+  while (oldPlan->readSite(site, oldBridges, &oldCounts))
   {
-    if (!vcf->getNextVariant(var1))
+    numSkipped += findSite(vcf, site, rec);
+    bool pair = !oldCounts.empty();
+    if (!pair)
+    {
+      // first variant of a sequence: nothing to decide
+      loadRow(0, rec);
+      newPlan->writeSite(site, oldBridges);
+      prev = site;
+      continue;
+    }
+    _blockStart = _rows.getNumVariants() - 1;
+    loadRow(1, rec);
+    {
+      StageTimer timer(_stats, Stats::LinkCounting);
+      computeLinkCounts(_rows.getRow(_blockStart),
+                        _rows.getRow(_blockStart + 1), newCounts);
+    }
+    bool sameSize = newCounts.size() == oldCounts.size();
+    for (size_t i = 0; sameSize && i < oldCounts.size(); ++i)
+    {
+      sameSize = newCounts[i].size() == oldCounts[i].size();
+    }
+    if (!sameSize)
+    {
+      stringstream ss;
+      ss << "Link counts of " << prev << " and " << site
+         << " don't match the plan";
+      throw runtime_error(ss.str());
+    }
+    for (size_t i = 0; i < oldCounts.size(); ++i)
+    {
+      for (size_t j = 0; j < oldCounts[i].size(); ++j)
+      {
+        oldCounts[i][j] += newCounts[i][j];
+      }
+    }
+
+    decision.bridges.clear();
+    decision.log.clear();
+    {
+      StageTimer timer(_stats, Stats::PhaseClassification);
+      decidePair(oldCounts, prev, site, decision);
+    }
+    cerr << decision.log;
+    ++numPairs;
+    bool changed = decision.bridges.size() != oldBridges.size();
+    for (size_t i = 0; i < decision.bridges.size(); ++i)
+    {
+      const BridgeDecision& bridge = decision.bridges[i];
+      _stats.countBridge(bridge.phase);
+      changed = changed || bridge.allele1 != oldBridges[i].allele1 ||
+         bridge.allele2 != oldBridges[i].allele2 ||
+         bridge.phase != oldBridges[i].phase;
+    }
+    if (changed)
     {
-      // empty file
-      cerr << "No variants found in VCF" << endl;
-      return;
+      ++numChanged;
     }
+    newPlan->writeSite(site, decision.bridges, &oldCounts);
+    swap(prev, site);
   }
-  _gv1.loadVariant(vg, var1);
+  cerr << "Bridges changed for " << numChanged << " of " << numPairs
+       << " pairs";
+  if (numSkipped > 0)
+  {
+    cerr << " (" << numSkipped << " vcf records not in the plan skipped)";
+  }
+  cerr << endl;
+  _diagnostics.report(cerr);
+}
 
-  int graphLen = vgRefLength(var1);
+size_t SNPBridge::findSite(GTReader* vcf, const VCFSite& site, GTRecord& rec)
+{
+  // the plan's sites are a subset of the vcf (overlaps were dropped),
+  // in the same order
+  size_t numSkipped = 0;
+  while (nextRecord(vcf, rec))
+  {
+    if (rec.sequenceName == site.sequenceName &&
+        rec.position == site.position && rec.alleles == site.alleles)
+    {
+      return numSkipped;
+    }
+    ++numSkipped;
+  }
+  stringstream ss;
+  ss << "Variant " << site << " of the plan not found in vcf";
+  throw runtime_error(ss.str());
+}
 
+void SNPBridge::applyPlan(VG* vg, BridgePlanReader* plan, int offset,
+                          int windowSize)
+{
+  _vg = vg;
+  _edits.init(vg);
+  _defaultOffset = offset;
+  _pathIndexes.clear();
+  initBlock();
 
-  for (; vcf->getNextVariant(var2); swap(var1, var2), swap(_gv1, _gv2))
+  VCFSite site;
+  vector<BridgeDecision> bridges;
+  bool more = plan->readSite(site, bridges);
+  if (!more)
+  {
+    cerr << "No variants found in plan" << endl;
+  }
+  while (more)
   {
+    string sequenceName = site.sequenceName;
+    int pathOffset = getOffset(sequenceName);
+    
+    // skip to first variant after offset.  its bridges are to a variant
+    // outside the graph so we ignore them
+    bool inGraph = hasPath(sequenceName);
+    while (more && site.sequenceName == sequenceName &&
+           (!inGraph || site.position < pathOffset))
+    {
+      more = plan->readSite(site, bridges);
+    }
+    if (!more || site.sequenceName != sequenceName)
+    {
+      continue;
+    }
+
+    const PathIndex& path = indexPath(sequenceName);
+    int graphEnd = pathOffset + getPathLength(sequenceName);
+    _sites[0] = site;
+    _gv1.init(&path, pathOffset);
+    _gv2.init(&path, pathOffset);
+    fetchVariant(_sites[0]);
+    _gv1.loadVariant(vg, _sites[0]);
+
+    bool inPath = true;
+    while (inPath)
+    {
+      int numRead = 0;
+      while (numRead < _blockSize)
+      {
+        more = plan->readSite(site, bridges);
+        if (!more || site.sequenceName != sequenceName)
+        {
+          inPath = false;
+          break;
+        }
+        if (site.position >= graphEnd)
+        {
+          // stop after end of vg
+          while (more && site.sequenceName == sequenceName)
+          {
+            more = plan->readSite(site, bridges);
+          }
+          inPath = false;
+          break;
+        }
+        ++numRead;
+        PairDecision& decision = _decisions[numRead];
+        _sites[numRead] = site;
+        decision.bridges.swap(bridges);
+        decision.inWindow = inWindow(_sites[numRead - 1], site, windowSize);
+        decision.log.clear();
+        decision.error.clear();
+      }
+      applyBlock(numRead);
+      swap(_sites[0], _sites[numRead]);
+    }
+    finishSequence(sequenceName);
+  }
+  _diagnostics.report(cerr);
+  reportSavings();
+}
+
+void SNPBridge::initBlock()
+{
+  _sites.resize(_blockSize + 1);
+  _records.resize(_blockSize + 1);
+  // the last row from before the block stays around for the link to it
+  _rows.init(_blockSize + 1);
+  _decisions.resize(_blockSize + 1);
+}
+
+void SNPBridge::getPathNames(vector<string>& pathNames) const
+{
+  pathNames.clear();
+  if (_window != NULL)
+  {
+    // in file order, so the window only ever has to move forward
+    pathNames = _window->getPathNames();
+  }
+  else
+  {
+    function<void(Path&)> lambda = [&](Path& path)
+    {
+      pathNames.push_back(path.name());
+    };
+    _vg->paths.for_each(lambda);
+  }
+}
+
+bool SNPBridge::hasPath(const string& pathName) const
+{
+  if (_window != NULL)
+  {
+    return _window->hasPath(pathName);
+  }
+  return _vg->paths.has_path(pathName);
+}
+
+int64_t SNPBridge::getPathLength(const string& pathName)
+{
+  if (_window != NULL)
+  {
+    return _window->getPathLength(pathName);
+  }
+  return indexPath(pathName).getLength();
+}
+
+void SNPBridge::fetchVariant(const VCFSite& var)
+{
+  if (_window == NULL)
+  {
+    return;
+  }
+  // load up to the node after the reference allele (its siblings are
+  // needed to find the alt alleles), then one more chunk to be sure
+  // everything attached to them is there too
+  PathIndex& path = _pathIndexes[var.sequenceName];
+  int64_t end = var.position - getOffset(var.sequenceName) +
+     var.alleles[0].length();
+  StageTimer timer(_stats, Stats::GraphLoad);
+  bool loaded = false;
+  while (path.getLength() <= end && _window->loadChunk())
+  {
+    path.extend(_vg);
+    loaded = true;
+  }
+  if (loaded && _window->loadChunk())
+  {
+    path.extend(_vg);
+  }
+  // now that everything around them is loaded, find the alt alleles
+  // of the reference nodes
+  int64_t lastRank = path.find(end - 1);
+  path.indexBubbles(_vg, lastRank < 0 ? path.getNumNodes() : lastRank + 1);
+}
+
+void SNPBridge::releaseGraph()
+{
+  if (_window == NULL)
+  {
+    return;
+  }
+  // everything before the node preceding _gv1 is done with
+  const string& pathName = _gv1.getVariant().sequenceName;
+  _pinned.clear();
+  for (int i = 0; i < _gv1.getNumAlleles(); ++i)
+  {
+    for (auto node : _gv1.getGraphAllele(i))
+    {
+      _pinned.push_back(node->id());
+    }
+  }
+  if (_window->canRelease(pathName, _gv1.getRank() - 1, _pinned))
+  {
+    // chunks are written straight from the graph, so it needs to be
+    // up to date
+    applyEdits();
+    StageTimer timer(_stats, Stats::Serialization);
+    _window->release(pathName, _gv1.getRank() - 1, _pinned);
+    _pathIndexes[pathName].trim(_vg);
+  }
+}
+
+void SNPBridge::finishSequence(const string& sequenceName)
+{
+  applyEdits();
+  if (_window == NULL)
+  {
+    return;
+  }
+  StageTimer timer(_stats, Stats::Serialization);
+  _window->finishPath(sequenceName);
+  _pathIndexes.erase(sequenceName);
+}
+
+int64_t SNPBridge::createNode(const string& sequence)
+{
+  if (_window != NULL)
+  {
+    // ids from the working graph could clash with nodes that haven't
+    // been loaded yet
+    return _edits.createNode(sequence, _window->newNodeId());
+  }
+  return _edits.createNode(sequence);
+}
+
+void SNPBridge::applyEdits()
+{
+  StageTimer timer(_stats, Stats::BridgeEditing);
+  _stats.count(Stats::NodesCreated, _edits.getNumNewNodes());
+  _stats.count(Stats::EdgesCreated, _edits.getNumNewEdges());
+  _stats.count(Stats::EdgesDestroyed, _edits.getNumDeletedEdges());
+  _edits.apply();
+}
+
+void SNPBridge::reportSavings() const
+{
+  cerr << "Shared bridge segments saved "
+       << _stats.getCount(Stats::SharedNodesSaved) << " nodes ("
+       << _stats.getCount(Stats::SharedBasesSaved) << " bases)" << endl;
+}
+
+int SNPBridge::getOffset(const string& sequenceName) const
+{
+  map<string, int>::const_iterator i = _offsets.find(sequenceName);
+  return i == _offsets.end() ? _defaultOffset : i->second;
+}
+
+bool SNPBridge::nextRecord(GTReader* vcf, GTRecord& rec)
+{
+  if (_havePending)
+  {
+    swap(rec, _pending);
+    _havePending = false;
+    return true;
+  }
+  StageTimer timer(_stats, Stats::VCFParse);
+  if (vcf->getNextRecord(rec))
+  {
+    _stats.count(Stats::VariantsRead);
+    return true;
+  }
+  return false;
+}
+
+void SNPBridge::pushBack(GTRecord& rec)
+{
+  assert(!_havePending);
+  swap(rec, _pending);
+  _havePending = true;
+}
+
+bool SNPBridge::readFirstVariant(GTReader* vcf, const string& sequenceName,
+                                 int offset, GTRecord& rec)
+{
+  // skip to first variant after offset
+  for (int vcfPos = -1; vcfPos < offset; vcfPos = rec.position)
+  {
+    if (!nextRecord(vcf, rec))
+    {
+      return false;
+    }
+    if (rec.sequenceName != sequenceName)
+    {
+      pushBack(rec);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SNPBridge::inWindow(const VCFSite& var1, const VCFSite& var2,
+                         int windowSize)
+{
+  return var2.position - (var1.position + var1.alleles[0].length() - 1) <=
+     windowSize;
+}
+
+bool SNPBridge::readBlock(GTReader* vcf, int graphEnd, GTRecord& var2,
+                          int& numRead)
+{
+  numRead = 0;
+  bool more = true;
+  while (more && numRead < _blockSize)
+  {
+    const VCFSite& var1 = _sites[numRead];
+    if (!nextRecord(vcf, var2))
+    {
+      more = false;
+      break;
+    }
+    
     // skip ahead until var2 doesn't overlap var1 or anything between
-    bool breakOut = false;
     int prev_position = var1.position + var1.alleles[0].size();
-    while (!breakOut && var2.position < prev_position)
+    while (more && var2.sequenceName == var1.sequenceName &&
+           var2.position < prev_position)
     {
-      cerr << "Skipping variant at " << var2.position << " because it "
-           << "overlaps previous variant at position " << var1.position << endl;
+      _stats.count(Stats::OverlapsSkipped);
+      if (_diagnostics.warn(Diagnostics::OverlapSkipped))
+      {
+        stringstream ss;
+        ss << "Skipping variant at " << var2 << " because it overlaps "
+           << "previous variant at " << var1;
+        _diagnostics.example(Diagnostics::OverlapSkipped, ss.str());
+      }
       prev_position = max(prev_position,
                           (int)(var2.position + var2.alleles[0].size()));
-      breakOut = !vcf->getNextVariant(var2);
+      more = nextRecord(vcf, var2);
+    }
+    if (!more)
+    {
+      break;
     }
-    if (breakOut)
+
+    if (var2.sequenceName != var1.sequenceName)
     {
+      // done this sequence.  leave record for the next one
+      pushBack(var2);
+      more = false;
       break;
     }
 
-    if (var2.position >= offset + graphLen)
+    if (var2.position >= graphEnd)
     {
       // stop after end of vg
+      more = false;
       break;
     }
-    
-    _gv2.loadVariant(vg, var2);
-    
-    if (var2.position - (var1.position + var1.alleles[0].length() - 1) >
-        windowSize)
+
+    ++numRead;
+    _sites[numRead] = var2;
+    // keep the record (its buffers go back to var2) to be decoded with
+    // the rest of the block
+    swap(_records[numRead], var2);
+  }
+  loadBlock(numRead);
+  if (more)
+  {
+    // the caller gets the last record of the block
+    var2 = _records[numRead];
+  }
+  return more;
+}
+
+void SNPBridge::loadRow(int k, const GTRecord& rec)
+{
+  if (k == 0)
+  {
+    // first variant of a sequence
+    _rows.clear();
+    _blockStart = 0;
+  }
+  {
+    StageTimer timer(_stats, Stats::VCFParse);
+    _rows.load(rec);
+  }
+  checkRow(k, rec);
+}
+
+void SNPBridge::loadBlock(int numRead)
+{
+  // decoding genotypes is most of the work of reading the vcf, and
+  // each row only depends on its own record.  the rows are reserved in
+  // order, then filled in by all threads
+  _blockRows.resize(numRead + 1);
+  for (int k = 1; k <= numRead; ++k)
+  {
+    _blockRows[k] = &_rows.push();
+  }
+  vector<string> errors(numRead + 1);
+  {
+    StageTimer timer(_stats, Stats::VCFParse);
+#pragma omp parallel for schedule(dynamic, 16) if (numRead > 1)
+    for (int k = 1; k <= numRead; ++k)
+    {
+      // exceptions can't leave an omp block
+      try
+      {
+        _blockRows[k]->load(_records[k]);
+      }
+      catch (const exception& e)
+      {
+        errors[k] = e.what();
+      }
+    }
+  }
+  for (int k = 1; k <= numRead; ++k)
+  {
+    if (!errors[k].empty())
+    {
+      throw runtime_error(errors[k]);
+    }
+    checkRow(k, _records[k]);
+  }
+}
+
+void SNPBridge::checkRow(int k, const GTRecord& rec)
+{
+  // treat missing GT information in one variant with respect to the
+  // other as a warning.  computeLinkCounts() will count all possible
+  // links once for the sample so it will never get phased.
+  const GenotypeRow& row = _rows.getRow(_blockStart + k);
+  for (int s = 0; row.getNumAbsent() > 0 && s < row.getNumSamples(); ++s)
+  {
+    if (row.getSamplePloidy(s) == 0 &&
+        _diagnostics.warn(Diagnostics::SampleMissing))
     {
+      stringstream ss;
+      ss << "Sample " << row.getSampleName(s) << " not found in variant "
+         << rec << ". Assuming unphased";
+      _diagnostics.example(Diagnostics::SampleMissing, ss.str());
+    }
+  }
+  assert(_rows.hasRow(_blockStart + k));
+}
+
+void SNPBridge::decideBlock(int numRead, int windowSize)
+{
+  // each pair only depends on its two genotype rows, so they can be
+  // classified in any order.  graph editing waits for applyBlock()
+  // (times are summed over threads)
+  double linkTime = 0.;
+  double phaseTime = 0.;
+#pragma omp parallel if (numRead > 1)
+  {
+    LinkCounts linkCounts;
+#pragma omp for schedule(dynamic, 16) reduction(+:linkTime, phaseTime)
+    for (int k = 1; k <= numRead; ++k)
+    {
+      const VCFSite& var1 = _sites[k - 1];
+      const VCFSite& var2 = _sites[k];
+      PairDecision& decision = _decisions[k];
+      decision.bridges.clear();
+      decision.log.clear();
+      decision.error.clear();
+      decision.inWindow = inWindow(var1, var2, windowSize);
+      if (decision.inWindow)
+      {
+        // exceptions can't leave an omp block, so hold on to the message
+        // and throw it when we get to this pair in applyBlock()
+        try
+        {
+          chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+          computeLinkCounts(_rows.getRow(_blockStart + k - 1),
+                            _rows.getRow(_blockStart + k), linkCounts);
+          chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+          decidePair(linkCounts, var1, var2, decision);
+          if (_keepCounts)
+          {
+            decision.counts = linkCounts;
+          }
+          chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+          linkTime += chrono::duration<double>(t1 - t0).count();
+          phaseTime += chrono::duration<double>(t2 - t1).count();
+        }
+        catch (const exception& e)
+        {
+          decision.error = e.what();
+        }
+      }
+    }
+  }
+  _stats.addTime(Stats::LinkCounting, linkTime);
+  _stats.addTime(Stats::PhaseClassification, phaseTime);
+}
+
+void SNPBridge::applyBlock(int numRead)
+{
+  for (int k = 1; k <= numRead; ++k, swap(_gv1, _gv2))
+  {
+    releaseGraph();
+    fetchVariant(_sites[k]);
+    _gv2.loadVariant(_vg, _sites[k]);
+
+    const PairDecision& decision = _decisions[k];
+    if (!decision.inWindow)
+    {
+      _stats.count(Stats::PairsOutsideWindow);
       // skip because further than window size
       continue;
     }
-
 #ifdef DEBUG
     cerr << "\nv1 " << _gv1 << endl << "v2 " << _gv2 << endl;
 #endif
+    if (!decision.error.empty())
+    {
+      throw runtime_error(decision.error);
+    }
+    cerr << decision.log;
 
-    computeLinkCounts(var1, var2);
+    // a stretch of reference is only ever between one pair, so the
+    // copies of the last pair can't be shared any more
+    _segments.clear();
+    StageTimer timer(_stats, Stats::BridgeEditing);
+    for (auto& bridge : decision.bridges)
+    {
+      _stats.countBridge(bridge.phase);
+      makeBridge(bridge.allele1, bridge.allele2, bridge.phase);
+    }
+  }
+  if (_edits.isFull())
+  {
+    applyEdits();
+  }
+}
+
+void SNPBridge::decidePair(const LinkCounts& linkCounts,
+                           const VCFSite& var1, const VCFSite& var2,
+                           PairDecision& decision) const
+{
+  stringstream log;
 #ifdef DEBUG
-    cerr << "Linkcounts: ";
-    for (int i = 0; i < _linkCounts.size(); ++i)
+  log << "Linkcounts: ";
+  for (int i = 0; i < var1.alleles.size(); ++i)
+  {
+    for (int j = 0; j < var2.alleles.size(); ++j)
     {
-      for (int j = 0; j < _linkCounts[i].size(); ++j)
-      {
-        cerr << "(" << i <<"-" << j << "=" << _linkCounts[i][j] << ") ";
-      }
+      log << "(" << i <<"-" << j << "=" << linkCounts[i][j] << ") ";
     }
-    cerr << endl;
+  }
+  log << endl;
 #endif
 
-    for (int a1 = 1; a1 < var1.alleles.size(); ++a1)
+  for (int a1 = 1; a1 < var1.alleles.size(); ++a1)
+  {
+    for (int a2 = 1; a2 < var2.alleles.size(); ++a2)
     {
-      for (int a2 = 1; a2 < var2.alleles.size(); ++a2)
-      {
-        // note can probably get what we need by calling once instead
-        // of in loop....
-        Phase phase = phaseRelation(var1, a1, var2, a2);
+      // note can probably get what we need by calling once instead
+      // of in loop....
+      Phase phase = phaseRelation(linkCounts, var1, a1, var2, a2);
 
-        if (phase != GT_OTHER)
-        {
-          makeBridge(a1, a2, phase);
-          // we can get away with breaking here (and below) because results
-          // mutually exclusive (see simplifying assumption in
-          // phaseRelation()).  So as soon as we see a GT_AND or
-          // GT_XOR, then everything else must be GT_OTHER
-          break;
-        }
-        else
-        {
+      if (phase != GT_OTHER)
+      {
+        BridgeDecision bridge = {a1, a2, phase};
+        decision.bridges.push_back(bridge);
+#ifdef DEBUG
+        log << a1 << " " << phase2str(phase) << " " << a2 << " detected at "
+            << var1.position << endl;
+#endif
+        // we can get away with breaking here (and below) because results
+        // mutually exclusive (see simplifying assumption in
+        // phaseRelation()).  So as soon as we see a GT_AND or
+        // GT_XOR, then everything else must be GT_OTHER
+        break;
+      }
+      else
+      {
 #ifdef DEBUG
-          cerr << a1 << " OTHER " << a2 << " detected at "
-               << _gv1.getVariant().position << " ";
-          for (int i = 0; i < _linkCounts.size(); ++i)
+        log << a1 << " OTHER " << a2 << " detected at "
+            << var1.position << " ";
+        for (int i = 0; i < var1.alleles.size(); ++i)
+        {
+          log << "(";
+          for (int j = 0; j < var2.alleles.size(); ++j)
           {
-            cerr << "(";
-            for (int j = 0; j < _linkCounts[i].size(); ++j)
-            {
-              cerr << _linkCounts[i][j] << ",";
-            }
-            cerr << ") ";
+            log << linkCounts[i][j] << ",";
           }
-          cerr << endl;
-#endif
+          log << ") ";
         }
+        log << endl;
+#endif
       }
     }
   }
+  decision.log = log.str();
 }
 
 void SNPBridge::makeBridge(int allele1, int allele2, Phase phase)
 {
-#ifdef DEBUG
-  cerr << allele1 << " " << phase2str(phase) << " " << allele2 << " detected at "
-       << _gv1.getVariant().position << " ";
-  for (int i = 0; i < _linkCounts.size(); ++i)
+  int64_t node1 = _gv1.getGraphAllele(allele1).back()->id();
+  int64_t ref1 = _gv1.getGraphAllele(0).back()->id();
+  int64_t node2 = _gv2.getGraphAllele(allele2).front()->id();
+  int64_t ref2 = _gv2.getGraphAllele(0).front()->id();
+  bool toAlt = phase == GT_AND || phase == GT_FROM_REF || phase == GT_TO_REF;
+
+  // find the path between the two variant alleles along the
+  // reference.  since we only deal with consecutive variants,
+  // it's sufficient to stick this path between
+  vector<Node*> refPath;
+  _gv1.getReferencePathTo(_gv2, refPath);
+
+  // an earlier bridge may have already made a copy of this stretch of
+  // reference that only leads back to the reference.  if so, we just
+  // add our allele as another way into it rather than making another
+  // copy.  a copy that leads to an alt allele is only ever wanted by
+  // one bridge: phaseRelation() gives GT_OTHER as soon as that allele
+  // is linked from two alts
+  int64_t shared = -1;
+  pair<int64_t, int64_t> interval;
+  if (!refPath.empty())
   {
-     cerr << "(";
-     for (int j = 0; j < _linkCounts[i].size(); ++j)
-     {
-       cerr << _linkCounts[i][j] << ",";
-     }
-     cerr << ") ";
+    interval = make_pair(refPath.front()->id(), refPath.back()->id());
+    map<pair<int64_t, int64_t>, int64_t>::const_iterator i =
+       _segments.find(interval);
+    if (!toAlt && i != _segments.end())
+    {
+      shared = i->second;
+    }
   }
-  cerr << endl;
-#endif
-
-  Node* node1 = _gv1.getGraphAllele(allele1).back();
-  Node* ref1 = _gv1.getGraphAllele(0).back();
-  Node* node2 = _gv2.getGraphAllele(allele2).front();
-  Node* ref2 = _gv2.getGraphAllele(0).front();
 
-  // note we don't use references here because they get altered by
-  // calls to create and destroy.
-  vector<pair<int64_t, bool> > outEdges1 = _vg->edges_on_end[node1->id()];
-  vector<pair<int64_t, bool> > inEdges2 = _vg->edges_on_start[node2->id()];
+  // edits are only logged here, and made in the graph in one go
+  // later.  the log's adjacencies include everything done so far.
+  vector<pair<int64_t, bool> > outEdges1;
+  vector<pair<int64_t, bool> > inEdges2;
+  _edits.edgesOnEnd(node1, outEdges1);
+  _edits.edgesOnStart(node2, inEdges2);
 
   // make sure there's no other way out of node1 but the
   // new bridges that we'll add
@@ -164,12 +1057,10 @@ void SNPBridge::makeBridge(int allele1, int allele2, Phase phase)
   {
     
 #ifdef DEBUG
-    cerr << "destroy1 " << node1->id() << " " << true << ", " << p.first << " " << p.second << endl;
+    cerr << "destroy1 " << node1 << " " << true << ", " << p.first << " " << p.second << endl;
 #endif
-    Edge* edge = _vg->get_edge(NodeSide(node1->id(), true),
-                               NodeSide(p.first, p.second));
-    assert(edge != NULL);
-    _vg->destroy_edge(edge);
+    assert(_edits.hasEdge(NodeSide(node1, true), NodeSide(p.first, p.second)));
+    _edits.destroyEdge(NodeSide(node1, true), NodeSide(p.first, p.second));
   }
 
   // make sure there's no other way into node 2 than
@@ -177,98 +1068,122 @@ void SNPBridge::makeBridge(int allele1, int allele2, Phase phase)
   for (auto p : inEdges2)
   {
 #ifdef DEBUG
-    cerr << "destroy2 " << p.first << " " << !p.second << ", " << node2->id() << " " << false << endl;
+    cerr << "destroy2 " << p.first << " " << !p.second << ", " << node2 << " " << false << endl;
 #endif
-    Edge* edge = _vg->get_edge(NodeSide(p.first, !p.second),
-                               NodeSide(node2->id(), false));
-    if (p.first == node1->id())
+    if (p.first == node1)
     {
       // should have been deleted above
-      assert(edge == NULL);
+      assert(!_edits.hasEdge(NodeSide(p.first, !p.second),
+                             NodeSide(node2, false)));
     }
     else
     {
-      assert(edge != NULL);
-      _vg->destroy_edge(edge);
+      assert(_edits.hasEdge(NodeSide(p.first, !p.second),
+                            NodeSide(node2, false)));
+      _edits.destroyEdge(NodeSide(p.first, !p.second), NodeSide(node2, false));
     }
   }
 
-  // find the path between the two variant alleles along the
-  // reference.  since we only deal with consecutive variants,
-  // it's sufficient to stick this path between
-  list<Node*> refPath;
-  _gv1.getReferencePathTo(_gv2, refPath);
-
   // if there's no path, we assume the variants are directly adjacent
   // and just stick edges between them
   if (refPath.empty())
   {
     if (phase == GT_AND || phase == GT_FROM_REF || phase == GT_TO_REF)
     {
-      _vg->create_edge(node1, node2, false, false);
+      _edits.createEdge(node1, node2);
 #ifdef DEBUG
-      cerr << "create adj alt-alt " << node1->id() << ", " << node2->id() << endl;
+      cerr << "create adj alt-alt " << node1 << ", " << node2 << endl;
 #endif
     }
     if (phase == GT_FROM_REF || phase == GT_XOR)
     {
-      _vg->create_edge(ref1, node2, false, false);
+      _edits.createEdge(ref1, node2);
 #ifdef DEBUG
-      cerr << "create adj ref-alt " << ref1->id() << ", " << node2->id() << endl;
+      cerr << "create adj ref-alt " << ref1 << ", " << node2 << endl;
 #endif
     }
     if (phase == GT_TO_REF || phase == GT_XOR)
     {
-      _vg->create_edge(node1, ref2, false, false);
+      _edits.createEdge(node1, ref2);
 #ifdef DEBUG
-      cerr << "create adj alt-ref " << node1->id() << ", " << ref2->id() << endl;
+      cerr << "create adj alt-ref " << node1 << ", " << ref2 << endl;
 #endif
     }
   }
   
+  // or a copy of the ref path we can share
+  else if (shared >= 0)
+  {
+    _edits.createEdge(node1, shared);
+#ifdef DEBUG
+    cerr << "share " << node1 << " -> " << shared << endl;
+#endif
+    if (phase == GT_FROM_REF || phase == GT_XOR)
+    {
+      _edits.createEdge(refPath.back()->id(), node2);
+    }
+    for (auto refNode : refPath)
+    {
+      _stats.count(Stats::SharedNodesSaved);
+      _stats.count(Stats::SharedBasesSaved, refNode->sequence().length());
+    }
+  }
+  
   // otherwise, make a copy of ref path and stick that in between
   else
   {
-    Node* prev = node1;
-    Node* refPrev = ref1;
+    int64_t prev = node1;
+    int64_t refPrev = ref1;
+    int64_t firstCopy = -1;
     for (auto refNode : refPath)
     {
-      Node* cpyNode = _vg->create_node(refNode->sequence());
-      _vg->create_edge(prev, cpyNode, false, false);
+      int64_t cpyNode = createNode(refNode->sequence());
+      if (firstCopy < 0)
+      {
+        firstCopy = cpyNode;
+      }
+      _edits.createEdge(prev, cpyNode);
 #ifdef DEBUG
-      cerr << "create " << cpyNode->id() << endl;
-      cerr << "create " << prev->id() << " -> " << cpyNode->id() << endl;
+      cerr << "create " << cpyNode << endl;
+      cerr << "create " << prev << " -> " << cpyNode << endl;
 #endif
       prev = cpyNode;
-      refPrev = refNode;
+      refPrev = refNode->id();
+    }
+
+    if (!toAlt)
+    {
+      _segments[interval] = firstCopy;
     }
 
     if (phase == GT_AND || phase == GT_FROM_REF || phase == GT_TO_REF)
     {
-      _vg->create_edge(prev, node2, false, false);
+      _edits.createEdge(prev, node2);
 #ifdef DEBUG
-      cerr << "create alt-alt " << prev->id() << ", " << node2->id() << endl;
+      cerr << "create alt-alt " << prev << ", " << node2 << endl;
 #endif
     }
     if (phase == GT_FROM_REF || phase == GT_XOR)
     {
-      _vg->create_edge(refPrev, node2, false, false);
+      _edits.createEdge(refPrev, node2);
 #ifdef DEBUG
-      cerr << "create ref-alt " << refPrev->id() << ", " << node2->id() << endl;
+      cerr << "create ref-alt " << refPrev << ", " << node2 << endl;
 #endif
     }
     if (phase == GT_TO_REF || phase == GT_XOR)
     {
-      _vg->create_edge(prev, ref2, false, false);
+      _edits.createEdge(prev, ref2);
 #ifdef DEBUG
-      cerr << "create alt-ref " << prev->id() << ", " << ref2->id() << endl;
+      cerr << "create alt-ref " << prev << ", " << ref2 << endl;
 #endif
     }
   }
 }
 
-SNPBridge::Phase SNPBridge::phaseRelation(Variant& v1, int allele1,
-                                        Variant& v2, int allele2) const
+SNPBridge::Phase SNPBridge::phaseRelation(const LinkCounts& linkCounts,
+                                          const VCFSite& v1, int allele1,
+                                          const VCFSite& v2, int allele2)
+                                          const
 {
   // this is where we could take into account allele
   // frequencies to, for example, ignore really rare alleles.
@@ -276,14 +1191,14 @@ SNPBridge::Phase SNPBridge::phaseRelation(Variant& v1, int allele1,
   // the variants are alt-alt only if there isn't a single sample
   // saying otherwise.
   
-  bool to_ref = _linkCounts[allele1][0] > 0;
-  bool from_ref = _linkCounts[0][allele2] > 0;
-  bool to_alt = _linkCounts[allele1][allele2] > 0;
+  bool to_ref = linkCounts[allele1][0] > 0;
+  bool from_ref = linkCounts[0][allele2] > 0;
+  bool to_alt = linkCounts[allele1][allele2] > 0;
 
   bool to_other_alt = false;
   for (int i = 1; i < v2.alleles.size(); ++i)
   {
-    if (i != allele2 && _linkCounts[allele1][i] > 0)
+    if (i != allele2 && linkCounts[allele1][i] > 0)
     {
       to_other_alt = true;
       break;
@@ -293,7 +1208,7 @@ SNPBridge::Phase SNPBridge::phaseRelation(Variant& v1, int allele1,
   bool from_other_alt = false;
   for (int i = 1; i < v1.alleles.size(); ++i)
   {
-    if (i != allele1 && _linkCounts[i][allele2] > 0)
+    if (i != allele1 && linkCounts[i][allele2] > 0)
     {
       from_other_alt = true;
       break;
@@ -323,19 +1238,19 @@ SNPBridge::Phase SNPBridge::phaseRelation(Variant& v1, int allele1,
   }
   else
   {
-    if (!to_ref)
+    if (!to_ref && _diagnostics.warn(Diagnostics::AlleleNeverSeen))
     {
-      cerr << "allele 1 " << allele1 << " to ref " << _linkCounts[allele1][0] << " and "
-           << "to_ref " << to_ref << endl;
-      cerr << "Alternate allele " << allele1 << " never seen in GT for "
-           << "variant " << v1 << endl;
+      stringstream ss;
+      ss << "Alternate allele " << allele1 << " never seen in GT for "
+         << "variant " << v1;
+      _diagnostics.example(Diagnostics::AlleleNeverSeen, ss.str());
     }
-    if (!from_ref)
+    if (!from_ref && _diagnostics.warn(Diagnostics::AlleleNeverSeen))
     {
-      cerr << "allele 2 " << allele2 << " from ref " << _linkCounts[0][allele2] << " and "
-           << "from_ref " << from_ref << endl;
-      cerr << "Alternate allele " << allele2 << " never seen in GT for "
-           << "variant " << v2 << endl;
+      stringstream ss;
+      ss << "Alternate allele " << allele2 << " never seen in GT for "
+         << "variant " << v2;
+      _diagnostics.example(Diagnostics::AlleleNeverSeen, ss.str());
     }
     return GT_XOR;
   }
@@ -343,155 +1258,120 @@ SNPBridge::Phase SNPBridge::phaseRelation(Variant& v1, int allele1,
   return GT_OTHER;
 }
 
-void SNPBridge::computeLinkCounts(Variant& v1, Variant& v2)
+void SNPBridge::computeLinkCounts(const GenotypeRow& r1,
+                                  const GenotypeRow& r2,
+                                  LinkCounts& linkCounts)
 {
   // make our matrix and set to 0
-  initLinkCounts(v1, v2);
+  initLinkCounts(r1, r2, linkCounts);
   
-  assert(!v1.alleles.empty() && !v2.alleles.empty());
+  assert(r1.getNumAlleles() > 0 && r2.getNumAlleles() > 0);
+  assert(r1.getNumSamples() == r2.getNumSamples());
 
-  for (auto& sample : v1.sampleNames)
+  // don't expect this but check in case
+  if (r1.getSamplePloidies() != r2.getSamplePloidies())
   {
-    // treat missing GT information in one variant with respect
-    // to the other as a warning. But count all possible links
-    // once so it will never get phased. 
-    if (v2.samples.find(sample) == v2.samples.end())
+    for (int s = 0; s < r1.getNumSamples(); ++s)
     {
-      cerr << "Warning: Sample " << sample << " not found in variant " << v2
-           << ". Assuming unphased" << endl;
-      for (auto& i : _linkCounts)
+      int p1 = r1.getSamplePloidy(s);
+      int p2 = r2.getSamplePloidy(s);
+      if (p1 != p2 && p1 > 0 && p2 > 0)
       {
-        for (auto& j : i)
-        {
-          ++j;
-        }
+        stringstream ss;
+        ss << "Sample " << r1.getSampleName(s) << " has different ploidy in "
+           << "consecutive variants. This is not supported";
+        throw runtime_error(ss.str());
       }
-    
-      continue;
-    }  
-
-    // parse out GT info for sample (it'll look like 0|1 etc.)
-    string& gt1 = v1.samples[sample]["GT"].front();
-    string& gt2 = v2.samples[sample]["GT"].front();
-    vector<string> gtspec1 = split(gt1, "|");
-    vector<string> gtspec2 = split(gt2, "|");
-
-    // don't expect this but check in case
-    if (gtspec1.size() != gtspec2.size())
-    {
-      stringstream ss;
-      ss << "Sample " << sample << "has different ploidy in "
-         << v1 << " and " << v2 << ". This is not supported";
-      throw runtime_error(ss.str());
     }
+  }
+  if (r1.getPloidy() != r2.getPloidy())
+  {
+    // only happens if the sample with the highest ploidy is absent
+    // from one of the rows, so the haplotype bits don't line up.
+    throw runtime_error("Samples with different ploidy missing from "
+                        "consecutive variants. This is not supported");
+  }
 
-    // so if the GT info looks like 0|1 1|0 2|1 etc.  we have
-    // two "chromosomes", and iterate each.  we count a link
-    // looking at the two variants, and recording what we see
-    // at the same chromosome at the same sample. 
-    for (int chrom = 0; chrom < gtspec1.size(); ++chrom)
-    {
-      // treat . as wildcard
-      if (gtspec1[chrom] == "." && gtspec2[chrom] == ".")
-      {
-        // two .'s mean we see everything
-        for (int g1 = 0; g1 < v1.alleles.size(); ++g1)
-        {
-          for (int g2 = 0; g2 < v2.alleles.size(); ++g2)
-          {
-            ++_linkCounts[g1][g2];
-          }
-        }
-      }
-      else if (gtspec1[chrom] == ".")
-      {
-        // g1 == . means we see all combindations of g1 with
-        // given value of g2
-        int g2;
-        convert(gtspec2[chrom], g2);
-        for (int g1 = 0; g1 < v1.alleles.size(); ++g1)
-        {
-          ++_linkCounts[g1][g2];
-        }
-      }
-      else if (gtspec2[chrom] == ".")
-      {
-        // g2 == . means we see all combinations of g2 with
-        // given value of g1
-        int g1;
-        convert(gtspec1[chrom], g1);
-        for (int g2 = 0; g2 < v2.alleles.size(); ++g2)
-        {
-          ++_linkCounts[g1][g2];
-        }
-      }
-      else
-      {
-        // normal case.  update the link count for the indexes
-        // found on the give allele.  Example
-        // Sample NA12878 has GT 0|1 for var1 and 0|0 for var2
-        // then we update _linkCounts[0][1] + 1 (when chrom = 0)
-        // and _linkCounots[0][0] + 1 (when chrom = 1)
-        int g1, g2;
-        convert(gtspec1[chrom], g1);
-        convert(gtspec2[chrom], g2);
-        ++_linkCounts[g1][g2];
-      }
-    }
+  // samples absent from either variant are treated as wildcards, but
+  // only counted once per sample (not once per chromosome)
+  int numAbsent = 0;
+  const vector<uint64_t>& absent1 = r1.getAbsentBits();
+  const vector<uint64_t>& absent2 = r2.getAbsentBits();
+  for (size_t w = 0; w < absent1.size(); ++w)
+  {
+    numAbsent += __builtin_popcountll(absent1[w] | absent2[w]);
   }
-}
 
-void SNPBridge::initLinkCounts(Variant& v1,
-                              Variant& v2)
-{
-  // set _linkCounts to 0 and make sure it's at least
-  // big enough to hold our alleles
-  for (int i = 0; i < v1.alleles.size(); ++i)
+  // each chromosome links its allele in r1 to its allele in r2.  a . in
+  // one variant is a wildcard: links to whatever is in the other (and
+  // everything if both are .).  Since each chromosome has exactly one
+  // allele or a ., the count for g1-g2 is the number of chromosomes in
+  // (g1 or . at r1) and (g2 or . at r2).
+  // Example: Sample NA12878 has GT 0|1 for var1 and 0|0 for var2
+  // then it contributes 1 to linkCounts[0][1] (chrom 0)
+  // and 1 to linkCounts[0][0] (chrom 1)
+  size_t numWords = r1.getNumWords();
+  const uint64_t* missing1 = r1.getMissingBits();
+  const uint64_t* missing2 = r2.getMissingBits();
+  for (int g1 = 0; g1 < r1.getNumAlleles(); ++g1)
   {
-    if (_linkCounts.size() < v1.alleles.size())
+    const uint64_t* bits1 = r1.getAlleleBits(g1);
+    for (int g2 = 0; g2 < r2.getNumAlleles(); ++g2)
     {
-      _linkCounts.push_back(vector<int>(v2.alleles.size(), 0));
-    }
-    else
-    {
-      if (_linkCounts[i].size() < v2.alleles.size())
+      const uint64_t* bits2 = r2.getAlleleBits(g2);
+      int count = numAbsent;
+      for (size_t w = 0; w < numWords; ++w)
       {
-        _linkCounts[i].resize(v2.alleles.size());
+        count += __builtin_popcountll((bits1[w] | missing1[w]) &
+                                      (bits2[w] | missing2[w]));
       }
-      _linkCounts[i].assign(v2.alleles.size(), 0);
+      linkCounts[g1][g2] = count;
     }
-  }  
+  }
 }
 
-int SNPBridge::vgRefLength(Variant& var) const
+void SNPBridge::initLinkCounts(const GenotypeRow& r1,
+                               const GenotypeRow& r2,
+                               LinkCounts& linkCounts)
 {
-  // duplicating some code from the built in traversal of graphvariant,
-  // but it's nice to have path length at outset to make scope checking
-  // simpler (to relax assumption that vg contains whole vcf). 
-  if (_vg->paths.has_path(var.sequenceName) == false)
+  // set linkCounts to 0 and make it exactly the size of our alleles
+  // (it's reused from pair to pair, and kept in plans)
+  int numAlleles1 = r1.getNumAlleles();
+  int numAlleles2 = r2.getNumAlleles();
+  linkCounts.resize(numAlleles1);
+  for (int i = 0; i < numAlleles1; ++i)
   {
-    stringstream ss;
-    ss << "Unable to find path for " << var.sequenceName << " in vg file";
-    throw runtime_error(ss.str());
+    linkCounts[i].assign(numAlleles2, 0);
   }
-  int len = 0;
-  list<Mapping>& path = _vg->paths.get_path(var.sequenceName);
-  for (auto& mapping : path)
+}
+
+const PathIndex& SNPBridge::indexPath(const string& pathName)
+{
+  // each path index is built once, and used for all variant lookups
+  // on that path
+  map<string, PathIndex>::iterator i = _pathIndexes.find(pathName);
+  if (i == _pathIndexes.end())
   {
-    if (mapping.position().is_reverse() == true)
+    PathIndex& index = _pathIndexes[pathName];
+    try
     {
-      throw(runtime_error("Reverse Mapping not supported"));
+      if (_window != NULL)
+      {
+        // only what's loaded so far.  fetchVariant() adds the rest
+        index.init(pathName);
+        index.extend(_vg);
+      }
+      else
+      {
+        index.build(_vg, pathName);
+      }
     }
-    if (mapping.edit_size() > 1 || (
-          mapping.edit_size() == 1 && mapping.edit(0).from_length() !=
-          mapping.edit(0).to_length()))
+    catch (...)
     {
-      stringstream ss;
-      ss << pb2json(mapping) << ": Only mappings with a single trvial edit"
-         << " supported in ref path";
-      throw runtime_error(ss.str());
+      _pathIndexes.erase(pathName);
+      throw;
     }
-    len += _vg->get_node(mapping.position().node_id())->sequence().length();
+    return index;
   }
-  return len;
+  return i->second;
 }
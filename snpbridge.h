@@ -11,12 +11,23 @@
 #include <vector>
 #include <limits>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include <sstream>
+#include <chrono>
 
 #include "vg/src/vg.hpp"
-#include "Variant.h"
 #include "graphvariant.h"
+#include "genotyperow.h"
+#include "graphedits.h"
+#include "stats.h"
+#include "diagnostics.h"
+#include "checkpoint.h"
+
+class BridgePlanWriter;
+class BridgePlanReader;
+class GraphWindow;
+class GraphDeltaWriter;
 
 /** 
     Let's say we have two adjacent snps, along with phasing information. 
@@ -84,17 +95,203 @@ public:
                GT_TO_REF, // link from Alt1 to Alt2 and Alt1 to ref
                GT_OTHER}; // all links (leave alone)
 
+   /** number of samples that have allele i at one variant and allele j
+    * at the other on the same chromosome is linkCounts[i][j] */
+   typedef std::vector<std::vector<int> > LinkCounts;
+
+   /** a bridge to make between alt alleles of two adjacent variants */
+   struct BridgeDecision
+   {
+      int allele1;
+      int allele2;
+      Phase phase;
+   };
+
+   /** everything we decide about a pair of adjacent variants */
+   struct PairDecision
+   {
+      bool inWindow;
+      std::vector<BridgeDecision> bridges;
+      /** warnings, kept until the pair is applied so they come out
+       * in order */
+      std::string log;
+      /** exception thrown while deciding, rethrown when applied */
+      std::string error;
+      /** link counts the bridges were decided from, if _keepCounts */
+      LinkCounts counts;
+   };
+
+   /** number of pairs classified at once when running with threads */
+   static const int ParallelBlockSize = 4096;
+
    SNPBridge();
    ~SNPBridge();
 
+   /** with more than one thread, variant pairs are classified in
+    * parallel blocks before being bridged in order.  The output graph
+    * is the same either way */
+   void setNumThreads(int numThreads);
+
+   /** stream the graph through a window instead of having it all in
+    * memory.  the graph passed to processGraph() and applyPlan() must
+    * then be window->getGraph() */
+   void setGraphWindow(GraphWindow* window);
+
+   /** write the edits made to the graph to delta as well (see
+    * GraphDeltaWriter) */
+   void setDeltaWriter(GraphDeltaWriter* delta);
+
+   /** save a Checkpoint to path, between blocks of variants, at least
+    * every interval seconds of processGraph().  the edits are taken
+    * from the delta writer, which must be set.  the names of the
+    * input files and the samples read are kept to check a resumed run
+    * uses the same ones */
+   void setCheckpoint(const std::string& path, double interval,
+                      const std::string& graphFile,
+                      const std::string& vcfFile,
+                      const std::vector<std::string>& samples);
+
+   /** have the next processGraph() carry on from a checkpoint instead
+    * of starting over.  the graph passed to it must be the input
+    * graph with the edits of the checkpoint's log already made */
+   void resumeFrom(const Checkpoint& checkpoint);
+
+   /** timers and counters for everything done so far */
+   Stats& getStats();
+
+   /** warnings about the vcf, summarized at the end of a run */
+   Diagnostics& getDiagnostics();
+
+   /** vcf-coordinate of the first position of each named path, for
+    * graphs whose paths don't all start at the same offset.  paths
+    * not in the map use the offset passed to processGraph() etc. */
+   void setPathOffsets(const std::map<std::string, int>& offsets);
+
    /** iterate through adjacent snps and do merging, in place, in the 
-    * vg graph */
-   void processGraph(vg::VG* vg, vcflib::VariantCallFile* vcf, int offset,
+    * vg graph.  every path in the graph is processed against the vcf
+    * records with the same sequence name */
+   void processGraph(vg::VG* vg, GTReader* vcf, int offset,
                      int windowSize);
 
+   /** decide all bridges from the vcf alone, and write them to plan
+    * so they can be applied to a graph later */
+   void makePlan(GTReader* vcf, int offset, BridgePlanWriter* plan);
+
+   /** redecide the bridges of a plan made with link counts when new
+    * samples come along.  vcf has the genotypes of the new samples (and
+    * at least the variants of the plan): their link counts are added to
+    * those in oldPlan and the new counts and bridges go to newPlan, which
+    * must be open with the old and new samples counted. */
+   void updatePlan(BridgePlanReader* oldPlan, GTReader* vcf,
+                   BridgePlanWriter* newPlan);
+
+   /** make the bridges in a plan (from makePlan()) in the vg graph.
+    * the same as processGraph() but without looking at any genotypes */
+   void applyPlan(vg::VG* vg, BridgePlanReader* plan, int offset,
+                  int windowSize);
+
 
 protected:
 
+   /** bridge all variants on one sequence (path) of the graph */
+   void processSequence(GTReader* vcf, const std::string& sequenceName,
+                        int windowSize);
+
+   /** size the block buffers */
+   void initBlock();
+
+   /** names of all paths in the graph */
+   void getPathNames(std::vector<std::string>& pathNames) const;
+
+   bool hasPath(const std::string& pathName) const;
+
+   /** length of a path in bases */
+   int64_t getPathLength(const std::string& pathName);
+
+   /** when streaming, make sure the graph is loaded far enough to
+    * find a variant */
+   void fetchVariant(const VCFSite& var);
+
+   /** when streaming, let go of the graph before _gv1 */
+   void releaseGraph();
+
+   /** when streaming, let go of the rest of a path */
+   void finishSequence(const std::string& sequenceName);
+
+   /** make the logged bridge edits in the graph */
+   void applyEdits();
+
+   /** print how much sharing bridge segments saved */
+   void reportSavings() const;
+
+   /** log a new node for a bridge.  returns its id */
+   int64_t createNode(const std::string& sequence);
+
+   /** offset of a path, from setPathOffsets() or the default */
+   int getOffset(const std::string& sequenceName) const;
+
+   /** next record from the vcf, or the one last pushed back */
+   bool nextRecord(GTReader* vcf, GTRecord& rec);
+
+   /** give a record back to be read again by nextRecord().  rec's
+    * contents are swapped out */
+   void pushBack(GTRecord& rec);
+
+   /** read the vcf up to and including the last variant of the
+    * checkpoint we're resuming, and put it (with the genotypes saved
+    * in the checkpoint) in rec */
+   void resumeSequence(GTReader* vcf, int offset, GTRecord& rec);
+
+   /** save a checkpoint if it's time.  rec is the record of _sites[0],
+    * which must be in _gv1 */
+   void saveCheckpoint(GTReader* vcf, const GTRecord& rec);
+
+   /** read up to the record of site in the vcf, into rec.  returns the
+    * number of records skipped on the way.  throws runtime_error if
+    * site isn't there */
+   size_t findSite(GTReader* vcf, const VCFSite& site, GTRecord& rec);
+
+   /** read up to the first variant on sequenceName at or after offset.
+    * false if none (leaving any record on another sequence to be
+    * read again) */
+   bool readFirstVariant(GTReader* vcf, const std::string& sequenceName,
+                         int offset, GTRecord& rec);
+
+   /** decode the genotypes of _sites[k] (rec) into _rows (and add it
+    * to the haplotype index if we're using one).  k = 0 starts a new
+    * sequence */
+   void loadRow(int k, const GTRecord& rec);
+
+   /** decode the genotypes of _records[1..numRead] into _rows, in
+    * parallel, then check them in order as loadRow() does */
+   void loadBlock(int numRead);
+
+   /** warn about samples missing from row k of the block (already
+    * in _rows), and add it to the haplotype index */
+   void checkRow(int k, const GTRecord& rec);
+
+   /** are two variants close enough to bridge */
+   static bool inWindow(const VCFSite& var1, const VCFSite& var2,
+                        int windowSize);
+
+   /** read (up to) a block of variants into _sites[1..numRead]
+    * and their rows into _rows, skipping overlaps.  returns false if
+    * nothing left to read on the current sequence */
+   bool readBlock(GTReader* vcf, int graphEnd, GTRecord& rec, int& numRead);
+
+   /** classify each pair (k-1, k) in block, filling in _decisions[k].
+    * Pure function of the genotypes so done in parallel */
+   void decideBlock(int numRead, int windowSize);
+
+   /** load each variant of the block into the graph and make the
+    * bridges, in order */
+   void applyBlock(int numRead);
+
+   /** find all bridges to make between two variants */
+   void decidePair(const LinkCounts& linkCounts,
+                   const VCFSite& var1, const VCFSite& var2,
+                   PairDecision& decision) const;
+
    /** Make a direct bridge from end of allele1 (in graph) to 
     * start of allele2. */
    void makeBridge(int allele1, int allele2, Phase phase);
@@ -107,35 +304,74 @@ protected:
     *
     * Important: need to call computeLinkCounts first. 
     */
-   Phase phaseRelation(vcflib::Variant& v1, int allele1,
-                       vcflib::Variant& v2, int allel2) const;
+   Phase phaseRelation(const LinkCounts& linkCounts,
+                       const VCFSite& v1, int allele1,
+                       const VCFSite& v2, int allel2) const;
 
 
    /** Count the number of samples that have each pair of allele variants
-    * on same haplotype, storing results in _linkCoutns array */
-   void computeLinkCounts(vcflib::Variant& v1,
-                          vcflib::Variant& v2);
+    * on same haplotype, storing results in linkCounts */
+   static void computeLinkCounts(const GenotypeRow& r1,
+                                 const GenotypeRow& r2,
+                                 LinkCounts& linkCounts);
 
    /** Resize and set matrix to 0 */
-   void initLinkCounts(vcflib::Variant& v1,
-                       vcflib::Variant& v2);
+   static void initLinkCounts(const GenotypeRow& r1,
+                              const GenotypeRow& r2,
+                              LinkCounts& linkCounts);
 
-   /** Check length of reference path */
-   int vgRefLength(vcflib::Variant& var) const;
+   /** get the index of a reference path, building it if necessary.
+    * indexes are kept for every path seen */
+   const PathIndex& indexPath(const std::string& pathName);
    
 protected:
 
    vg::VG* _vg;
+   GraphWindow* _window;
+   GraphDeltaWriter* _delta;
+   /** bridges are logged here and applied to _vg in batches */
+   GraphEdits _edits;
+   /** first node of each copy of the reference that only leads back to
+    * the reference, by the ids of the first and last reference nodes
+    * it copies.  bridges across the same stretch share it */
+   std::map<std::pair<int64_t, int64_t>, int64_t> _segments;
+   Stats _stats;
+   /** counted from const (and parallel) code, so mutable */
+   mutable Diagnostics _diagnostics;
+   /** nodes of _gv1, which the window mustn't let go of */
+   std::vector<int64_t> _pinned;
+   std::map<std::string, PathIndex> _pathIndexes;
+   std::map<std::string, int> _offsets;
+   int _defaultOffset;
+   GTRecord _pending;
+   bool _havePending;
    GraphVariant _gv1;
    GraphVariant _gv2;
+   int _blockSize;
+
+   /** current block of variants.  item 0 is the last variant of
+    * the previous block */
+   std::vector<VCFSite> _sites;
+   /** records of the block, kept until their genotypes are decoded */
+   std::vector<GTRecord> _records;
+   /** where each record of the block is decoded to */
+   std::vector<GenotypeRow*> _blockRows;
+   /** decoded genotypes, by variant number along the sequence.  each
+    * record is decoded once and used by every pair it's in */
+   GenotypeRowRing _rows;
+   /** variant number of _sites[0] */
+   int64_t _blockStart;
+   /** keep the link counts of each PairDecision, for the plan */
+   bool _keepCounts;
+   /** _decisions[k] is for the pair _sites[k-1], _sites[k] */
+   std::vector<PairDecision> _decisions;
 
-   /** store the number of samples that have a pair variants on
-    * the same allele.  These numbers can be used to tell if
-    * to snps, for instance, area lways ref-ref / alt-alt.
-    * so _linkCoutnos[1][1] = X would mean X samples
-    * have alt1-alt1 for the two variants in consideration
-    * on same chromosome. */
-   std::vector<std::vector<int> > _linkCounts;
+   std::string _checkpointPath;
+   double _checkpointInterval;
+   std::chrono::steady_clock::time_point _lastCheckpoint;
+   /** where processGraph() has got to, or is to resume from */
+   Checkpoint _checkpoint;
+   bool _resuming;
 };
 
 inline std::string phase2str(SNPBridge::Phase phase)
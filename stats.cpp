@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include "stats.h"
+#include "snpbridge.h"
+
+using namespace std;
+
+static const char* StageNames[] = {"graph_load", "vcf_parse",
+                                   "link_counting", "phase_classification",
+                                   "bridge_editing", "serialization",
+                                   "total"};
+
+static const char* CounterNames[] = {"variants_read", "overlaps_skipped",
+                                     "pairs_outside_window", "nodes_created",
+                                     "edges_created", "edges_destroyed",
+                                     "shared_nodes_saved",
+                                     "shared_bases_saved"};
+
+static const int NumPhases = SNPBridge::GT_OTHER + 1;
+
+Stats::Stats() : _times(NumStages, 0.), _counts(NumCounters, 0),
+                 _bridges(NumPhases, 0)
+{
+}
+
+Stats::~Stats()
+{
+}
+
+void Stats::addTime(Stage stage, double seconds)
+{
+  _times[stage] += seconds;
+}
+
+void Stats::count(Counter counter, size_t n)
+{
+  _counts[counter] += n;
+}
+
+void Stats::countBridge(int phase)
+{
+  ++_bridges[phase];
+}
+
+double Stats::getTime(Stage stage) const
+{
+  return _times[stage];
+}
+
+size_t Stats::getCount(Counter counter) const
+{
+  return _counts[counter];
+}
+
+size_t Stats::getBridgeCount(int phase) const
+{
+  return _bridges[phase];
+}
+
+void Stats::writeJSON(ostream& os) const
+{
+  os << "{" << endl << "  \"seconds\": {";
+  for (int i = 0; i < NumStages; ++i)
+  {
+    os << (i > 0 ? "," : "") << endl
+       << "    \"" << StageNames[i] << "\": " << _times[i];
+  }
+  os << endl << "  }," << endl << "  \"counts\": {";
+  for (int i = 0; i < NumCounters; ++i)
+  {
+    os << (i > 0 ? "," : "") << endl
+       << "    \"" << CounterNames[i] << "\": " << _counts[i];
+  }
+  os << endl << "  }," << endl << "  \"bridges\": {";
+  for (int i = 0; i < NumPhases; ++i)
+  {
+    os << (i > 0 ? "," : "") << endl
+       << "    \"" << phase2str((SNPBridge::Phase)i) << "\": " << _bridges[i];
+  }
+  os << endl << "  }" << endl << "}" << endl;
+}
+
+StageTimer::StageTimer(Stats& stats, Stats::Stage stage) :
+  _stats(stats), _stage(stage), _start(chrono::steady_clock::now())
+{
+}
+
+StageTimer::~StageTimer()
+{
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - _start;
+  _stats.addTime(_stage, elapsed.count());
+}
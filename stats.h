@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cstddef>
+
+/**
+Wall time spent in each stage of a run, and counts of what was done,
+so they can be written out as JSON at the end.
+*/
+class Stats
+{
+public:
+
+   enum Stage {GraphLoad = 0, VCFParse, LinkCounting, PhaseClassification,
+               BridgeEditing, Serialization, Total, NumStages};
+
+   enum Counter {VariantsRead = 0, OverlapsSkipped, PairsOutsideWindow,
+                 NodesCreated, EdgesCreated, EdgesDestroyed,
+                 SharedNodesSaved, SharedBasesSaved, NumCounters};
+
+   Stats();
+   ~Stats();
+
+   /** add seconds to a stage */
+   void addTime(Stage stage, double seconds);
+
+   /** add to a counter */
+   void count(Counter counter, size_t n = 1);
+
+   /** count a bridge with the given SNPBridge::Phase */
+   void countBridge(int phase);
+
+   double getTime(Stage stage) const;
+   size_t getCount(Counter counter) const;
+   size_t getBridgeCount(int phase) const;
+
+   /** write everything as a JSON object */
+   void writeJSON(std::ostream& os) const;
+
+protected:
+
+   std::vector<double> _times;
+   std::vector<size_t> _counts;
+   std::vector<size_t> _bridges;
+};
+
+/**
+Add the time between construction and destruction to a stage.
+*/
+class StageTimer
+{
+public:
+   StageTimer(Stats& stats, Stats::Stage stage);
+   ~StageTimer();
+
+protected:
+
+   Stats& _stats;
+   Stats::Stage _stage;
+   std::chrono::steady_clock::time_point _start;
+};
+
+#endif
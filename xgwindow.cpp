@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+#include "xgwindow.h"
+
+using namespace vg;
+using namespace std;
+
+XGWindow::XGWindow() : _xg(NULL), _nextRank(1)
+{
+}
+
+XGWindow::~XGWindow()
+{
+  delete _xg;
+}
+
+void XGWindow::open(const string& path, GraphChunkWriter* writer)
+{
+  init(path, writer);
+  delete _xg;
+  _xg = NULL;
+  _pathPositions.clear();
+  _pathRanks.clear();
+  _nextRank = 1;
+
+  ifstream in(path.c_str(), ios::binary);
+  if (!in.good())
+  {
+    throw runtime_error("Could not read " + path);
+  }
+  _xg = new xg::XG(in);
+
+  // no need for a first pass: the index has it all.  ranks start
+  // at 1, and are in id order
+  for (size_t rank = 1; rank <= _xg->path_count; ++rank)
+  {
+    string name = _xg->path_name(rank);
+    _pathNames.push_back(name);
+    _pathLengths[name] = _xg->path_length(name);
+  }
+  if (_xg->node_count > 0)
+  {
+    _maxId = _xg->rank_to_id(_xg->node_count);
+  }
+}
+
+bool XGWindow::readChunk(Graph& chunk)
+{
+  if (_xg == NULL || _nextRank > _xg->node_count)
+  {
+    return false;
+  }
+  chunk.Clear();
+  size_t lastRank = min(_nextRank + ChunkSize - 1, _xg->node_count);
+  int64_t lastId = _xg->rank_to_id(lastRank);
+  map<int64_t, int64_t> nodeLengths;
+  set<pair<NodeSide, NodeSide> > seen;
+  for (size_t rank = _nextRank; rank <= lastRank; ++rank)
+  {
+    int64_t id = _xg->rank_to_id(rank);
+    Node* node = chunk.add_node();
+    node->set_id(id);
+    node->set_sequence(_xg->node_sequence(id));
+    nodeLengths[id] = node->sequence().length();
+    seen.clear();
+    for (auto& edge : _xg->edges_of(id))
+    {
+      if (max(edge.from(), edge.to()) == id &&
+          seen.insert(GraphEdits::edgeSides(edge)).second)
+      {
+        *chunk.add_edge() = edge;
+      }
+    }
+  }
+  _nextRank = lastRank + 1;
+
+  // every path, up to the last node of the chunk
+  for (auto& name : _pathNames)
+  {
+    int64_t& pos = _pathPositions[name];
+    int64_t length = _pathLengths[name];
+    Path* path = NULL;
+    while (pos < length)
+    {
+      int64_t id = _xg->node_at_path_position(name, pos);
+      if (id > lastId)
+      {
+        break;
+      }
+      if (path == NULL)
+      {
+        path = chunk.add_path();
+        path->set_name(name);
+      }
+      Mapping* mapping = path->add_mapping();
+      mapping->mutable_position()->set_node_id(id);
+      mapping->set_rank(++_pathRanks[name]);
+      map<int64_t, int64_t>::iterator l = nodeLengths.find(id);
+      int64_t nodeLength = l != nodeLengths.end() ? l->second :
+         _xg->node_sequence(id).length();
+      if (nodeLength == 0)
+      {
+        stringstream ss;
+        ss << "Empty node " << id << " on path " << name << " in " << _path;
+        throw runtime_error(ss.str());
+      }
+      pos += nodeLength;
+    }
+  }
+  return true;
+}
+
+void XGWindow::copyRest()
+{
+  if (_writer == NULL)
+  {
+    return;
+  }
+  Graph chunk;
+  while (readChunk(chunk))
+  {
+    filterEdges(chunk);
+    _writer->writeChunk(chunk);
+  }
+}
+
+bool isXG(const string& path)
+{
+  return path.length() > 3 &&
+     path.compare(path.length() - 3, 3, ".xg") == 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2015 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.cactus
+ */
+
+#ifndef _XGWINDOW_H
+#define _XGWINDOW_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+
+#include "vg/src/vg.hpp"
+#include "xg.hpp"
+#include "graphwindow.h"
+
+/**
+A GraphWindow over an xg index instead of a vg file.  The index stays
+in memory in its succinct form and answers nothing but the window's
+questions: the paths, their lengths and the largest id when opened,
+then the nodes, edges and path mappings of each chunk as the variants
+get to it.  Everything else (the lookups of GraphVariant, the bridges
+made by SNPBridge) happens in the window's small working graph, which
+holds the edits until the chunks they're in are written, so the
+output is the whole graph with the bridges merged in.
+
+Chunks are ChunkSize nodes, in id order, and each edge is read with
+the chunk of the larger of its two ids, so it's only read once.  Like
+GraphWindow this relies on the vg construct node order (paths visit
+nodes in increasing id order).
+*/
+class XGWindow : public GraphWindow
+{
+public:
+
+   /** number of nodes in a chunk */
+   static const size_t ChunkSize = 1000;
+
+   XGWindow();
+   virtual ~XGWindow();
+
+   /** load the xg index.  throws runtime_error on failure */
+   virtual void open(const std::string& path, GraphChunkWriter* writer);
+
+protected:
+
+   /** the next ChunkSize nodes, their edges back to nodes already
+    * read, and the mappings of every path up to the last of them */
+   virtual bool readChunk(vg::Graph& chunk);
+
+   /** read and write every chunk left in the index */
+   virtual void copyRest();
+
+protected:
+
+   xg::XG* _xg;
+   /** rank in the index of the next node to read */
+   size_t _nextRank;
+   /** offset along each path of the next mapping to read */
+   std::map<std::string, int64_t> _pathPositions;
+   std::map<std::string, int64_t> _pathRanks;
+};
+
+/** does a file name end in .xg */
+bool isXG(const std::string& path);
+
+#endif